@@ -0,0 +1,271 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Audio.c - Audio-to-haptics envelope extraction
+
+Abstract:
+
+	Turns blocks of 16-bit PCM into a low-frequency amplitude envelope that
+	drives the vibrator. Samples are rectified and summed per motor update
+	period (a boxcar low-pass that also decimates to the update rate), then
+	smoothed by a one-pole attack/release filter.
+
+	The rectify-and-sum kernel is vectorized with SSE2 on x64 and NEON on
+	ARM64, where the kernel allows vector registers without saving extended
+	state. Other targets use the scalar loop. The kernel does not depend on
+	any driver state, so it can be lifted into a user-mode benchmark as is.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "audio.tmh"
+
+#if defined(_M_AMD64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm64_neon.h>
+#endif
+
+#define AUDIO_Q15_ONE 32768
+
+static
+LONG
+SamsungHapticsAudioCoefficient(
+	_In_ ULONG UpdateRate,
+	_In_ ULONG TimeConstantMs
+)
+/*++
+Routine Description:
+
+	One-pole smoothing coefficient in Q15 for a time constant, using the
+	alpha = T / (tau + T) approximation so no floating point is needed.
+
+--*/
+{
+	ULONGLONG tauTimesRate = (ULONGLONG)TimeConstantMs * UpdateRate;
+
+	return (LONG)(((ULONGLONG)AUDIO_Q15_ONE * 1000) / (tauTimesRate + 1000));
+}
+
+ULONGLONG
+SamsungHapticsAudioRectifySum(
+	_In_reads_(Count) const SHORT* Samples,
+	_In_ ULONG Count
+)
+/*++
+Routine Description:
+
+	Sum of the absolute values of Count samples. -32768 saturates to 32767.
+
+--*/
+{
+	ULONGLONG sum = 0;
+	ULONG i = 0;
+
+#if defined(_M_AMD64)
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+
+	while (Count - i >= 8)
+	{
+		//
+		// Accumulate at most 8192 vectors into 32-bit lanes before
+		// widening: each lane gains at most 2 * 32767 per vector.
+		//
+		ULONG vectors = min((Count - i) / 8, 8192);
+		__m128i acc = zero;
+		__m128i acc64;
+
+		for (ULONG v = 0; v < vectors; v++, i += 8)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)&Samples[i]);
+			__m128i a = _mm_max_epi16(x, _mm_subs_epi16(zero, x));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(a, ones));
+		}
+
+		acc64 = _mm_add_epi64(
+			_mm_unpacklo_epi32(acc, zero),
+			_mm_unpackhi_epi32(acc, zero));
+		sum += (ULONGLONG)_mm_cvtsi128_si64(acc64) +
+			(ULONGLONG)_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc64, acc64));
+	}
+#elif defined(_M_ARM64)
+	while (Count - i >= 8)
+	{
+		ULONG vectors = min((Count - i) / 8, 8192);
+		uint32x4_t acc = vdupq_n_u32(0);
+
+		for (ULONG v = 0; v < vectors; v++, i += 8)
+		{
+			int16x8_t x = vld1q_s16(&Samples[i]);
+			acc = vpadalq_u16(acc, vreinterpretq_u16_s16(vqabsq_s16(x)));
+		}
+
+		sum += vaddlvq_u32(acc);
+	}
+#endif
+
+	for (; i < Count; i++)
+	{
+		LONG x = Samples[i];
+		sum += (ULONG)((x < 0) ? min(-x, 32767) : x);
+	}
+
+	return sum;
+}
+
+NTSTATUS
+SamsungHapticsAudioConfigure(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ const SAMSUNG_HAPTICS_AUDIO_CONFIG* Config
+)
+{
+	PSAMSUNG_HAPTICS_AUDIO_STATE audio = &devContext->Audio;
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_HAPTICS, "%!FUNC! Entry");
+
+	if (Config->SampleRate == 0 ||
+		Config->Channels == 0 ||
+		Config->Channels > SAMSUNG_HAPTICS_AUDIO_MAX_CHANNELS ||
+		Config->UpdateRate == 0 ||
+		Config->UpdateRate > Config->SampleRate ||
+		Config->ThresholdPercent > 100)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	RtlZeroMemory(audio, sizeof(*audio));
+
+	audio->SamplesPerUpdate = (Config->SampleRate / Config->UpdateRate) * Config->Channels;
+	audio->AttackCoefficient = SamsungHapticsAudioCoefficient(Config->UpdateRate, Config->AttackMs);
+	audio->ReleaseCoefficient = SamsungHapticsAudioCoefficient(Config->UpdateRate, Config->ReleaseMs);
+	audio->Gain = Config->Gain;
+	audio->ThresholdPercent = Config->ThresholdPercent;
+	audio->Configured = TRUE;
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_HAPTICS,
+		"Audio input: %u samples per update, attack %d release %d (Q15)",
+		audio->SamplesPerUpdate,
+		audio->AttackCoefficient,
+		audio->ReleaseCoefficient);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+SamsungHapticsAudioSubmit(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_reads_(SampleCount) const SHORT* Samples,
+	_In_ ULONG SampleCount,
+	_Out_ PSAMSUNG_HAPTICS_AUDIO_RESULT Result
+)
+/*++
+Routine Description:
+
+	Extract the envelope from one block of PCM and drive the motor with the
+	most recent update. Updates are expected to arrive at roughly the motor
+	update rate, so only the newest value is written to the pin; the full
+	decimated sequence is kept in the preallocated Updates array.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_AUDIO_STATE audio = &devContext->Audio;
+	ULONG offset = 0;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	Result->UpdatesProduced = 0;
+	Result->LastIntensity = audio->LastIntensity;
+
+	if (!audio->Configured)
+	{
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	audio->UpdateCount = 0;
+
+	while (offset < SampleCount)
+	{
+		ULONG chunk = min(SampleCount - offset, audio->SamplesPerUpdate - audio->AccumulatedSamples);
+		LONG mean;
+		LONG coefficient;
+		ULONG intensity;
+
+		audio->AccumulatedSum += SamsungHapticsAudioRectifySum(&Samples[offset], chunk);
+		audio->AccumulatedSamples += chunk;
+		offset += chunk;
+
+		if (audio->AccumulatedSamples < audio->SamplesPerUpdate)
+		{
+			break;
+		}
+
+		mean = (LONG)(audio->AccumulatedSum / audio->AccumulatedSamples);
+		audio->AccumulatedSum = 0;
+		audio->AccumulatedSamples = 0;
+
+		coefficient = (mean > audio->Envelope) ? audio->AttackCoefficient : audio->ReleaseCoefficient;
+		audio->Envelope += (LONG)(((LONGLONG)(mean - audio->Envelope) * coefficient) / AUDIO_Q15_ONE);
+
+		intensity = (ULONG)((((ULONGLONG)audio->Envelope * audio->Gain) >> 8) * 100 / 32767);
+		intensity = min(intensity, 100);
+
+		if (audio->UpdateCount < SAMSUNG_HAPTICS_AUDIO_MAX_UPDATES)
+		{
+			audio->Updates[audio->UpdateCount++] = (UCHAR)intensity;
+		}
+		else
+		{
+			//
+			// Keep the newest values when a block spans more updates than
+			// the buffer holds.
+			//
+			RtlMoveMemory(&audio->Updates[0], &audio->Updates[1], SAMSUNG_HAPTICS_AUDIO_MAX_UPDATES - 1);
+			audio->Updates[SAMSUNG_HAPTICS_AUDIO_MAX_UPDATES - 1] = (UCHAR)intensity;
+		}
+
+		Result->UpdatesProduced++;
+	}
+
+	if (Result->UpdatesProduced != 0)
+	{
+		ULONG intensity = audio->Updates[min(audio->UpdateCount, SAMSUNG_HAPTICS_AUDIO_MAX_UPDATES) - 1];
+
+		if (intensity < audio->ThresholdPercent)
+		{
+			intensity = 0;
+		}
+
+		if (intensity != audio->LastIntensity)
+		{
+			WdfWaitLockAcquire(devContext->OutputLock, NULL);
+			status = (intensity != 0) ?
+				SamsungHapticsMixerSetVoice(
+					devContext,
+					SamsungHapticsVoiceAudio,
+					intensity,
+					0,
+					SamsungHapticsPriorityLow,
+					SamsungHapticsPreemptResume) :
+				SamsungHapticsMixerClearVoice(devContext, SamsungHapticsVoiceAudio);
+			WdfWaitLockRelease(devContext->OutputLock);
+			if (NT_SUCCESS(status))
+			{
+				audio->LastIntensity = intensity;
+			}
+		}
+
+		Result->LastIntensity = audio->LastIntensity;
+	}
+
+	return status;
+}
@@ -0,0 +1,73 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Audio.h
+
+Abstract:
+
+	Audio-to-haptics envelope extraction definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+#define SAMSUNG_HAPTICS_AUDIO_MAX_UPDATES 64
+
+typedef struct _SAMSUNG_HAPTICS_AUDIO_STATE
+{
+	BOOLEAN   Configured;
+
+	ULONG     SamplesPerUpdate;     // input samples (all channels) per motor update
+	ULONG     AccumulatedSamples;   // samples summed towards the next update
+	ULONGLONG AccumulatedSum;       // sum of rectified samples
+
+	LONG      Envelope;             // filtered envelope, 0..32767
+	LONG      AttackCoefficient;    // Q15 one-pole coefficient while rising
+	LONG      ReleaseCoefficient;   // Q15 one-pole coefficient while falling
+	ULONG     Gain;                 // Q8
+	ULONG     ThresholdPercent;
+	ULONG     LastIntensity;
+
+	//
+	// Decimated output of the last block, preallocated so that the
+	// submit path never allocates.
+	//
+	ULONG     UpdateCount;
+	UCHAR     Updates[SAMSUNG_HAPTICS_AUDIO_MAX_UPDATES];
+} SAMSUNG_HAPTICS_AUDIO_STATE, * PSAMSUNG_HAPTICS_AUDIO_STATE;
+
+struct _DEVICE_CONTEXT;
+
+NTSTATUS
+SamsungHapticsAudioConfigure(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ const SAMSUNG_HAPTICS_AUDIO_CONFIG* Config
+);
+
+NTSTATUS
+SamsungHapticsAudioSubmit(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_reads_(SampleCount) const SHORT* Samples,
+	_In_ ULONG SampleCount,
+	_Out_ PSAMSUNG_HAPTICS_AUDIO_RESULT Result
+);
+
+ULONGLONG
+SamsungHapticsAudioRectifySum(
+	_In_reads_(Count) const SHORT* Samples,
+	_In_ ULONG Count
+);
+
+EXTERN_C_END
@@ -0,0 +1,236 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Calibration.c - Pin write latency calibration
+
+Abstract:
+
+	What a pin write costs depends on the SoC, the GPIO controller driver
+	and the output backend, and every timed edge lands late by that much.
+	When the device first starts, and on request, a burst of writes is
+	issued with the motor held off (the pin is rewritten low) and the round
+	trip of each is measured. The result is kept across power transitions.
+
+	The median becomes the lead by which the effect timer issues its edges
+	ahead of their deadlines. The 99th percentile bounds the modulator
+	carrier: at 50% intensity every tick writes the pin, so the tick period
+	must leave room for the slowest writes. The profile's carrier rate is
+	capped at that limit.
+
+	Each sample takes OutputLock on its own, so effects are never held off
+	by more than one write. Samples are skipped while the motor is driven;
+	a run with too few samples fails and leaves the previous results.
+
+	A run requested through the IOCTL also repeats each sample through
+	the generic pin writer, which picks the backend on every write, so the
+	gain of the specialized writer can be read on the device.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "calibration.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsCalibrate)
+#pragma alloc_text (PAGE, SamsungHapticsCalibrationQuery)
+#endif
+
+//
+// Longest lead applied to timed edges, in ns. Anything slower is a
+// misbehaving path rather than a cost worth compensating.
+//
+#define CALIBRATION_MAX_LEAD_NS 1000000
+
+VOID
+SamsungHapticsCalibrationInitialize(
+	_Out_ PSAMSUNG_HAPTICS_CALIBRATION_STATE Calibration
+)
+{
+	RtlZeroMemory(Calibration, sizeof(*Calibration));
+	Calibration->Result.Status = STATUS_DEVICE_NOT_READY;
+	Calibration->Result.CarrierLimit = SAMSUNG_HAPTICS_MODULATOR_MAX_TICK_RATE;
+}
+
+static
+VOID
+SamsungHapticsCalibrationSort(
+	_Inout_updates_(Count) PULONG Samples,
+	_In_ ULONG Count
+)
+{
+	ULONG i;
+	ULONG j;
+
+	for (i = 1; i < Count; i++) {
+		ULONG value = Samples[i];
+
+		for (j = i; j > 0 && Samples[j - 1] > value; j--) {
+			Samples[j] = Samples[j - 1];
+		}
+
+		Samples[j] = value;
+	}
+}
+
+NTSTATUS
+SamsungHapticsCalibrate(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_Out_opt_ PSAMSUNG_HAPTICS_CALIBRATION Result
+)
+/*++
+Routine Description:
+
+	Measure the pin write round trip, publish the lead and carrier limit,
+	and re-apply the profile's carrier rate under the new limit.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_CALIBRATION_STATE calibration = &devContext->Calibration;
+	ULONG samples[SAMSUNG_HAPTICS_CALIBRATION_SAMPLES];
+	ULONG genericSamples[SAMSUNG_HAPTICS_CALIBRATION_SAMPLES];
+	ULONG count = 0;
+	ULONG i;
+	LARGE_INTEGER frequency;
+	SAMSUNG_HAPTICS_MODULATOR_CONFIG modulatorConfig;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	PAGED_CODE();
+
+	KeQueryPerformanceCounter(&frequency);
+
+	for (i = 0; i < SAMSUNG_HAPTICS_CALIBRATION_SAMPLES; i++) {
+		LARGE_INTEGER start;
+		LARGE_INTEGER end;
+
+		WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+		if (devContext->Stopped) {
+			WdfWaitLockRelease(devContext->OutputLock);
+			status = STATUS_DEVICE_NOT_READY;
+			break;
+		}
+
+		if (devContext->Effect.Active || devContext->Modulator.TimerRunning || devContext->PinLevel != 0) {
+			WdfWaitLockRelease(devContext->OutputLock);
+			continue;
+		}
+
+		start = KeQueryPerformanceCounter(NULL);
+		status = GpioWritePin(devContext, 0);
+		end = KeQueryPerformanceCounter(NULL);
+
+		genericSamples[count] = 0;
+		if (NT_SUCCESS(status) && Result != NULL) {
+			LARGE_INTEGER genericStart = KeQueryPerformanceCounter(NULL);
+
+			status = SamsungHapticsWritePinGeneric(devContext, 0);
+			genericSamples[count] = (ULONG)min(
+				(ULONGLONG)(KeQueryPerformanceCounter(NULL).QuadPart - genericStart.QuadPart) * 1000000000ULL /
+				(ULONGLONG)frequency.QuadPart,
+				MAXULONG);
+		}
+
+		WdfWaitLockRelease(devContext->OutputLock);
+
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		samples[count++] = (ULONG)min(
+			(ULONGLONG)(end.QuadPart - start.QuadPart) * 1000000000ULL / (ULONGLONG)frequency.QuadPart,
+			MAXULONG);
+	}
+
+	if (NT_SUCCESS(status) && count < SAMSUNG_HAPTICS_CALIBRATION_SAMPLES / 2) {
+		status = STATUS_DEVICE_BUSY;
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	calibration->Result.Status = status;
+	calibration->Result.Runs++;
+
+	if (NT_SUCCESS(status)) {
+		PSAMSUNG_HAPTICS_CALIBRATION result = &calibration->Result;
+
+		SamsungHapticsCalibrationSort(samples, count);
+		SamsungHapticsCalibrationSort(genericSamples, count);
+
+		result->Samples = count;
+		result->MinNs = samples[0];
+		result->MedianNs = samples[count / 2];
+		result->P99Ns = samples[(count * 99 + 99) / 100 - 1];
+		result->MaxNs = samples[count - 1];
+		result->GenericMedianNs = genericSamples[count / 2];
+		result->LeadNs = min(result->MedianNs, CALIBRATION_MAX_LEAD_NS);
+		result->CarrierLimit = (result->P99Ns != 0) ?
+			(ULONG)min(max(1000000000ULL / (2ULL * result->P99Ns), SAMSUNG_HAPTICS_MODULATOR_MIN_TICK_RATE),
+				SAMSUNG_HAPTICS_MODULATOR_MAX_TICK_RATE) :
+			SAMSUNG_HAPTICS_MODULATOR_MAX_TICK_RATE;
+		result->Timestamp = KeQueryInterruptTime();
+
+		calibration->Lead = result->LeadNs / 100;
+	}
+
+	if (Result != NULL) {
+		*Result = calibration->Result;
+	}
+
+	modulatorConfig.DeviceIndex = devContext->RegistryIndex;
+	modulatorConfig.Modulation = devContext->Profile->Modulation;
+	modulatorConfig.TickRate = devContext->Profile->CarrierRate;
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_HAPTICS, "Calibration failed with %u samples - %!STATUS!", count, status);
+		return status;
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_HAPTICS,
+		"Pin write calibrated: median %u ns, p99 %u ns, carrier limit %u/s",
+		calibration->Result.MedianNs,
+		calibration->Result.P99Ns,
+		calibration->Result.CarrierLimit);
+
+	return SamsungHapticsModulatorConfigure(devContext, &modulatorConfig);
+}
+
+ULONG
+SamsungHapticsCalibrationCarrier(
+	_In_ PDEVICE_CONTEXT devContext,
+	_In_ ULONG TickRate
+)
+/*++
+Routine Description:
+
+	Cap a modulator tick rate at what the pin path was measured to
+	sustain.
+
+--*/
+{
+	return min(TickRate, ReadULongNoFence(&devContext->Calibration.Result.CarrierLimit));
+}
+
+VOID
+SamsungHapticsCalibrationQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_CALIBRATION Result
+)
+{
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+	*Result = devContext->Calibration.Result;
+	WdfWaitLockRelease(devContext->OutputLock);
+}
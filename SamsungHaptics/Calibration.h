@@ -0,0 +1,57 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Calibration.h
+
+Abstract:
+
+	Pin write calibration definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+typedef struct _SAMSUNG_HAPTICS_CALIBRATION_STATE
+{
+	SAMSUNG_HAPTICS_CALIBRATION Result;
+	ULONGLONG Lead;          // LeadNs in interrupt time units, read by the effect timer
+} SAMSUNG_HAPTICS_CALIBRATION_STATE, * PSAMSUNG_HAPTICS_CALIBRATION_STATE;
+
+struct _DEVICE_CONTEXT;
+
+VOID
+SamsungHapticsCalibrationInitialize(
+	_Out_ PSAMSUNG_HAPTICS_CALIBRATION_STATE Calibration
+);
+
+NTSTATUS
+SamsungHapticsCalibrate(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_Out_opt_ PSAMSUNG_HAPTICS_CALIBRATION Result
+);
+
+ULONG
+SamsungHapticsCalibrationCarrier(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONG TickRate
+);
+
+VOID
+SamsungHapticsCalibrationQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_CALIBRATION Result
+);
+
+EXTERN_C_END
@@ -0,0 +1,986 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Control.c - Control device for requests outside the HwN interface
+
+Abstract:
+
+	A single non-PnP control device is created per driver. Requests name
+	their target SECHWN instance by registry index, so one handle can reach
+	every motor on the board.
+
+	A live control device keeps the driver from unloading, so it only
+	exists while at least one SECHWN device does: it is created when the
+	first device initializes and deleted when the last one goes away.
+
+	Only the system and administrators can open the device, and each
+	request requires the read or write access encoded in its code.
+
+	Play requests are handled as they arrive, in parallel, so a critical
+	effect never waits behind a slow request such as a calibration or a
+	reload. Replays, which can run for a minute, get a queue of their own,
+	and every other request is forwarded to a queue that processes them
+	one at a time.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include <wdmsec.h>
+#include "control.h"
+#include "hwndefs.h"
+#include "control.tmh"
+
+static
+VOID
+SamsungHapticsControlProcess(
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoControlCode
+);
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsControlDeviceCreate)
+#pragma alloc_text (PAGE, SamsungHapticsControlDeviceDelete)
+#pragma alloc_text (PAGE, SamsungHapticsControlDeviceReference)
+#pragma alloc_text (PAGE, SamsungHapticsControlDeviceRelease)
+#pragma alloc_text (PAGE, SamsungHapticsEvtControlIoDeviceControl)
+#pragma alloc_text (PAGE, SamsungHapticsEvtControlSerialIoDeviceControl)
+#pragma alloc_text (PAGE, SamsungHapticsControlProcess)
+#endif
+
+static WDFDEVICE SamsungHapticsControlDevice = NULL;
+
+//
+// Queues of the requests processed one at a time, and whether one of them
+// is being processed
+//
+static WDFQUEUE SamsungHapticsControlSerialQueue = NULL;
+static WDFQUEUE SamsungHapticsControlReplayQueue = NULL;
+static LONG SamsungHapticsControlSerialActive = 0;
+
+//
+// SECHWN devices holding the control device, under the control lock. The
+// lock is taken unsafe inside a critical region rather than with
+// ExAcquireFastMutex, which raises to APC_LEVEL: creating and deleting the
+// control device under it needs PASSIVE_LEVEL.
+//
+static FAST_MUTEX SamsungHapticsControlLock;
+static ULONG SamsungHapticsControlUsers = 0;
+
+VOID
+SamsungHapticsControlInitialize(
+	VOID
+)
+{
+	ExInitializeFastMutex(&SamsungHapticsControlLock);
+}
+
+NTSTATUS
+SamsungHapticsControlDeviceCreate(
+	_In_ WDFDRIVER Driver
+)
+/*++
+Routine Description:
+
+	Create the control device, its symbolic link and its default queue.
+
+Arguments:
+
+	Driver - the framework driver object.
+
+Return Value:
+
+	NTSTATUS
+
+--*/
+{
+	NTSTATUS status;
+	PWDFDEVICE_INIT deviceInit;
+	WDFDEVICE controlDevice = NULL;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDF_IO_QUEUE_CONFIG queueConfig;
+	DECLARE_CONST_UNICODE_STRING(deviceName, SAMSUNG_HAPTICS_CONTROL_DEVICE_NAME);
+	DECLARE_CONST_UNICODE_STRING(symbolicName, SAMSUNG_HAPTICS_CONTROL_SYMBOLIC_NAME);
+
+	PAGED_CODE();
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
+
+	deviceInit = WdfControlDeviceInitAllocate(Driver, &SDDL_DEVOBJ_SYS_ALL_ADM_ALL);
+	if (deviceInit == NULL) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfControlDeviceInitAllocate failed");
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	WdfDeviceInitSetCharacteristics(deviceInit, FILE_DEVICE_SECURE_OPEN, FALSE);
+
+	status = WdfDeviceInitAssignName(deviceInit, &deviceName);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDeviceInitAssignName failed %!STATUS!", status);
+		WdfDeviceInitFree(deviceInit);
+		return status;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	status = WdfDeviceCreate(&deviceInit, &attributes, &controlDevice);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDeviceCreate failed %!STATUS!", status);
+		WdfDeviceInitFree(deviceInit);
+		return status;
+	}
+
+	status = WdfDeviceCreateSymbolicLink(controlDevice, &symbolicName);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDeviceCreateSymbolicLink failed %!STATUS!", status);
+		goto exit;
+	}
+
+	//
+	// Requests end up in GpioWritePin, which sends synchronous IOCTLs.
+	//
+	WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(&queueConfig, WdfIoQueueDispatchParallel);
+	queueConfig.EvtIoDeviceControl = SamsungHapticsEvtControlIoDeviceControl;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+	status = WdfIoQueueCreate(controlDevice, &queueConfig, &attributes, WDF_NO_HANDLE);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfIoQueueCreate failed %!STATUS!", status);
+		goto exit;
+	}
+
+	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchSequential);
+	queueConfig.EvtIoDeviceControl = SamsungHapticsEvtControlSerialIoDeviceControl;
+
+	status = WdfIoQueueCreate(controlDevice, &queueConfig, &attributes, &SamsungHapticsControlSerialQueue);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfIoQueueCreate failed %!STATUS!", status);
+		goto exit;
+	}
+
+	status = WdfIoQueueCreate(controlDevice, &queueConfig, &attributes, &SamsungHapticsControlReplayQueue);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfIoQueueCreate failed %!STATUS!", status);
+		goto exit;
+	}
+
+	status = SamsungHapticsStreamQueueCreate(controlDevice);
+	if (!NT_SUCCESS(status)) {
+		goto exit;
+	}
+
+	WdfControlFinishInitializing(controlDevice);
+	SamsungHapticsControlDevice = controlDevice;
+
+exit:
+	if (!NT_SUCCESS(status)) {
+		WdfObjectDelete(controlDevice);
+		SamsungHapticsControlSerialQueue = NULL;
+		SamsungHapticsControlReplayQueue = NULL;
+	}
+
+	return status;
+}
+
+VOID
+SamsungHapticsControlDeviceDelete(
+	VOID
+)
+{
+	PAGED_CODE();
+
+	if (SamsungHapticsControlDevice != NULL) {
+		WdfObjectDelete(SamsungHapticsControlDevice);
+		SamsungHapticsControlDevice = NULL;
+		SamsungHapticsControlSerialQueue = NULL;
+		SamsungHapticsControlReplayQueue = NULL;
+	}
+}
+
+VOID
+SamsungHapticsControlDeviceReference(
+	VOID
+)
+/*++
+Routine Description:
+
+	Account for a SECHWN device that may be reached through the control
+	device, creating the control device for the first one. The control
+	device only carries optional features, so failing to create it is not
+	fatal; it is retried when the next device arrives.
+
+--*/
+{
+	NTSTATUS status;
+
+	PAGED_CODE();
+
+	KeEnterCriticalRegion();
+	ExAcquireFastMutexUnsafe(&SamsungHapticsControlLock);
+
+	SamsungHapticsControlUsers++;
+
+	if (SamsungHapticsControlDevice == NULL) {
+		status = SamsungHapticsControlDeviceCreate(WdfGetDriver());
+		if (!NT_SUCCESS(status)) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_DRIVER, "SamsungHapticsControlDeviceCreate failed %!STATUS!", status);
+		}
+	}
+
+	ExReleaseFastMutexUnsafe(&SamsungHapticsControlLock);
+	KeLeaveCriticalRegion();
+}
+
+VOID
+SamsungHapticsControlDeviceRelease(
+	VOID
+)
+/*++
+Routine Description:
+
+	Drop the reference of a SECHWN device going away, deleting the control
+	device with the last one so that the driver can unload.
+
+--*/
+{
+	PAGED_CODE();
+
+	KeEnterCriticalRegion();
+	ExAcquireFastMutexUnsafe(&SamsungHapticsControlLock);
+
+	if (--SamsungHapticsControlUsers == 0) {
+		SamsungHapticsControlDeviceDelete();
+	}
+
+	ExReleaseFastMutexUnsafe(&SamsungHapticsControlLock);
+	KeLeaveCriticalRegion();
+}
+
+static
+NTSTATUS
+SamsungHapticsControlRetrieveTarget(
+	_In_ WDFREQUEST Request,
+	_In_ size_t MinimumLength,
+	_Out_ PVOID* Buffer,
+	_Out_ size_t* Length,
+	_Out_ PDEVICE_CONTEXT* devContext
+)
+/*++
+Routine Description:
+
+	Fetch the input buffer of a control request and reference the SECHWN
+	instance named by its leading registry index.
+
+--*/
+{
+	NTSTATUS status;
+
+	*devContext = NULL;
+
+	status = WdfRequestRetrieveInputBuffer(Request, MinimumLength, Buffer, Length);
+	if (!NT_SUCCESS(status)) {
+		return status;
+	}
+
+	*devContext = SamsungHapticsReferenceDeviceContext(*(PULONG)*Buffer);
+	if (*devContext == NULL) {
+		return STATUS_NO_SUCH_DEVICE;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+BOOLEAN
+SamsungHapticsControlSerialBusy(
+	VOID
+)
+/*++
+Routine Description:
+
+	Tell whether a request of the serial queue is being processed, so that
+	the play path can account for the latency it sees next to one.
+
+--*/
+{
+	return ReadNoFence(&SamsungHapticsControlSerialActive) != 0;
+}
+
+VOID
+SamsungHapticsEvtControlIoDeviceControl(
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ size_t OutputBufferLength,
+	_In_ size_t InputBufferLength,
+	_In_ ULONG IoControlCode
+)
+/*++
+Routine Description:
+
+	Handle play requests at once and forward the rest to a serial queue.
+
+--*/
+{
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(Queue);
+	UNREFERENCED_PARAMETER(OutputBufferLength);
+	UNREFERENCED_PARAMETER(InputBufferLength);
+
+	PAGED_CODE();
+
+	switch (IoControlCode)
+	{
+	case IOCTL_SAMSUNG_HAPTICS_PLAY:
+	case IOCTL_SAMSUNG_HAPTICS_PLAY_EFFECT:
+	{
+		SamsungHapticsControlProcess(Request, IoControlCode);
+		return;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_REPLAY:
+	{
+		status = WdfRequestForwardToIoQueue(Request, SamsungHapticsControlReplayQueue);
+		break;
+	}
+	default:
+	{
+		status = WdfRequestForwardToIoQueue(Request, SamsungHapticsControlSerialQueue);
+		break;
+	}
+	}
+
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfRequestForwardToIoQueue failed %!STATUS!", status);
+		WdfRequestComplete(Request, status);
+	}
+}
+
+VOID
+SamsungHapticsEvtControlSerialIoDeviceControl(
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ size_t OutputBufferLength,
+	_In_ size_t InputBufferLength,
+	_In_ ULONG IoControlCode
+)
+{
+	UNREFERENCED_PARAMETER(Queue);
+	UNREFERENCED_PARAMETER(OutputBufferLength);
+	UNREFERENCED_PARAMETER(InputBufferLength);
+
+	PAGED_CODE();
+
+	InterlockedIncrement(&SamsungHapticsControlSerialActive);
+	SamsungHapticsControlProcess(Request, IoControlCode);
+	InterlockedDecrement(&SamsungHapticsControlSerialActive);
+}
+
+static
+VOID
+SamsungHapticsControlProcess(
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoControlCode
+)
+/*++
+Routine Description:
+
+	Process a control request and complete it, unless it is left pending.
+
+--*/
+{
+	NTSTATUS status;
+	PVOID inputBuffer = NULL;
+	size_t inputLength = 0;
+	PVOID outputBuffer = NULL;
+	ULONG_PTR information = 0;
+	PDEVICE_CONTEXT devContext = NULL;
+
+	PAGED_CODE();
+
+	switch (IoControlCode)
+	{
+	case IOCTL_SAMSUNG_HAPTICS_AUDIO_CONFIGURE:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(SAMSUNG_HAPTICS_AUDIO_CONFIG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsAudioConfigure(devContext, (PSAMSUNG_HAPTICS_AUDIO_CONFIG)inputBuffer);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_AUDIO_SUBMIT:
+	{
+		PSAMSUNG_HAPTICS_AUDIO_BLOCK block;
+
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			SAMSUNG_HAPTICS_AUDIO_BLOCK_HEADER_SIZE,
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		block = (PSAMSUNG_HAPTICS_AUDIO_BLOCK)inputBuffer;
+		if (block->SampleCount > SAMSUNG_HAPTICS_AUDIO_MAX_BLOCK_SAMPLES ||
+			inputLength < SAMSUNG_HAPTICS_AUDIO_BLOCK_HEADER_SIZE + (size_t)block->SampleCount * sizeof(SHORT)) {
+			status = STATUS_INVALID_BUFFER_SIZE;
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_AUDIO_RESULT), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		//
+		// The output buffer aliases the input for METHOD_BUFFERED, so the
+		// samples are consumed before the result is written.
+		//
+		{
+			SAMSUNG_HAPTICS_AUDIO_RESULT result;
+
+			status = SamsungHapticsAudioSubmit(devContext, block->Samples, block->SampleCount, &result);
+			*(PSAMSUNG_HAPTICS_AUDIO_RESULT)outputBuffer = result;
+			information = sizeof(result);
+		}
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_MODULATOR_CONFIGURE:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(SAMSUNG_HAPTICS_MODULATOR_CONFIG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsModulatorConfigure(devContext, (PSAMSUNG_HAPTICS_MODULATOR_CONFIG)inputBuffer);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_MODULATOR_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_MODULATOR_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsModulatorQuery(devContext, (PSAMSUNG_HAPTICS_MODULATOR_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_MODULATOR_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_MOTOR_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_MOTOR_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		WdfWaitLockAcquire(devContext->OutputLock, NULL);
+		SamsungHapticsMotorModelQuery(&devContext->Motor, (PSAMSUNG_HAPTICS_MOTOR_STATISTICS)outputBuffer);
+		WdfWaitLockRelease(devContext->OutputLock);
+
+		information = sizeof(SAMSUNG_HAPTICS_MOTOR_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_OUTPUT_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_OUTPUT_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsOutputQuery(devContext, (PSAMSUNG_HAPTICS_OUTPUT_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_OUTPUT_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_PROFILE_RELOAD:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsProfileLoad(devContext);
+		if (NT_SUCCESS(status)) {
+			status = SamsungHapticsLibraryLoad(devContext);
+		}
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_PREARM:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(SAMSUNG_HAPTICS_PREARM),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsPrearm(devContext, ((PSAMSUNG_HAPTICS_PREARM)inputBuffer)->LeaseMs);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_PREARM_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_PREARM_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsPrearmQuery(devContext, (PSAMSUNG_HAPTICS_PREARM_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_PREARM_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_TIMER_QUERY:
+	{
+		PSAMSUNG_HAPTICS_TIMER_QUERY_RESULT result;
+
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_TIMER_QUERY_RESULT), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		result = (PSAMSUNG_HAPTICS_TIMER_QUERY_RESULT)outputBuffer;
+		SamsungHapticsTimerQuery(&devContext->Modulator.Timer, &result->Modulator);
+		SamsungHapticsTimerQuery(&devContext->Effect.Timer, &result->Effect);
+		information = sizeof(SAMSUNG_HAPTICS_TIMER_QUERY_RESULT);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_PLAY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(SAMSUNG_HAPTICS_PLAY),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsMixerPlay(devContext, (PSAMSUNG_HAPTICS_PLAY)inputBuffer);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_MIXER_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_MIXER_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsMixerQuery(devContext, (PSAMSUNG_HAPTICS_MIXER_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_MIXER_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_POWER_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_POWER_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsPowerQuery(devContext, (PSAMSUNG_HAPTICS_POWER_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_POWER_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_SAVER_CONFIGURE:
+	{
+		//
+		// Driver-wide: no target device to resolve.
+		//
+		status = WdfRequestRetrieveInputBuffer(Request, sizeof(SAMSUNG_HAPTICS_SAVER_CONFIG), &inputBuffer, &inputLength);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsSaverConfigure((PSAMSUNG_HAPTICS_SAVER_CONFIG)inputBuffer);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_SAVER_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_SAVER_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsSaverQuery(devContext, (PSAMSUNG_HAPTICS_SAVER_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_SAVER_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_RECORD_START:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(SAMSUNG_HAPTICS_RECORD_START),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsRecorderStart(
+			&devContext->Recorder,
+			((PSAMSUNG_HAPTICS_RECORD_START)inputBuffer)->RingSize);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_RECORD_STOP:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsRecorderStop(&devContext->Recorder);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_RECORD_READ:
+	{
+		size_t outputLength;
+		size_t written = 0;
+
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_RECORDING), &outputBuffer, &outputLength);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsRecorderRead(&devContext->Recorder, outputBuffer, outputLength, &written);
+		information = written;
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_REPLAY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(SAMSUNG_HAPTICS_REPLAY),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_REPLAY_RESULT), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsRecorderReplay(
+			devContext,
+			Request,
+			(PSAMSUNG_HAPTICS_REPLAY)inputBuffer,
+			inputLength,
+			(PSAMSUNG_HAPTICS_REPLAY_RESULT)outputBuffer);
+		if (NT_SUCCESS(status)) {
+			information = sizeof(SAMSUNG_HAPTICS_REPLAY_RESULT);
+		}
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_CONCURRENCY_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_CONCURRENCY_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsConcurrencyQuery(devContext, (PSAMSUNG_HAPTICS_CONCURRENCY_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_CONCURRENCY_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_PLAY_EFFECT:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(SAMSUNG_HAPTICS_PLAY_EFFECT),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsLibraryPlay(devContext, (PSAMSUNG_HAPTICS_PLAY_EFFECT)inputBuffer);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_LIBRARY_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_LIBRARY_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsLibraryQuery(devContext, (PSAMSUNG_HAPTICS_LIBRARY_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_LIBRARY_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_CALIBRATE:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_CALIBRATION), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsCalibrate(devContext, (PSAMSUNG_HAPTICS_CALIBRATION)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_CALIBRATION);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_CALIBRATION_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_CALIBRATION), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsCalibrationQuery(devContext, (PSAMSUNG_HAPTICS_CALIBRATION)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_CALIBRATION);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_SCHEDULE_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_SCHEDULE_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsScheduleQuery(devContext, (PSAMSUNG_HAPTICS_SCHEDULE_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_SCHEDULE_STATISTICS);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_STREAM_ATTACH:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		//
+		// Stays pending in the stream queue while attached.
+		//
+		status = SamsungHapticsStreamAttach(devContext, Request);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_STREAM_DETACH:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = SamsungHapticsStreamDetach(devContext);
+		break;
+	}
+	case IOCTL_SAMSUNG_HAPTICS_STREAM_QUERY:
+	{
+		status = SamsungHapticsControlRetrieveTarget(
+			Request,
+			sizeof(ULONG),
+			&inputBuffer,
+			&inputLength,
+			&devContext);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SAMSUNG_HAPTICS_STREAM_STATISTICS), &outputBuffer, NULL);
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		SamsungHapticsStreamQuery(devContext, (PSAMSUNG_HAPTICS_STREAM_STATISTICS)outputBuffer);
+		information = sizeof(SAMSUNG_HAPTICS_STREAM_STATISTICS);
+		break;
+	}
+	default:
+	{
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		break;
+	}
+	}
+
+	if (devContext != NULL) {
+		SamsungHapticsDereferenceDeviceContext(devContext);
+	}
+
+	if (status != STATUS_PENDING) {
+		WdfRequestCompleteWithInformation(Request, status, information);
+	}
+}
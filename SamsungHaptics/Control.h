@@ -0,0 +1,57 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Control.h
+
+Abstract:
+
+	Driver-wide control device definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+EXTERN_C_START
+
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL SamsungHapticsEvtControlIoDeviceControl;
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL SamsungHapticsEvtControlSerialIoDeviceControl;
+
+NTSTATUS
+SamsungHapticsControlDeviceCreate(
+	_In_ WDFDRIVER Driver
+);
+
+VOID
+SamsungHapticsControlDeviceDelete(
+	VOID
+);
+
+VOID
+SamsungHapticsControlInitialize(
+	VOID
+);
+
+VOID
+SamsungHapticsControlDeviceReference(
+	VOID
+);
+
+VOID
+SamsungHapticsControlDeviceRelease(
+	VOID
+);
+
+BOOLEAN
+SamsungHapticsControlSerialBusy(
+	VOID
+);
+
+EXTERN_C_END
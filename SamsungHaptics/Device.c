@@ -21,17 +21,86 @@ Environment:
 #include "device.tmh"
 #include <gpio.h>
 
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsDirectOutputInitialize)
+#pragma alloc_text (PAGE, SamsungHapticsDirectOutputUninitialize)
+#pragma alloc_text (PAGE, SamsungHapticsPowerQuery)
+#pragma alloc_text (PAGE, SamsungHapticsCpuCountersInitialize)
+#pragma alloc_text (PAGE, SamsungHapticsCpuCountersUninitialize)
+#endif
+
+//
+// Registry values (device hardware key) enabling the direct backend
+//
+#define DIRECT_OUTPUT_ENABLE_VALUE   L"DirectOutputEnable"
+#define DIRECT_OUTPUT_REGISTER_VALUE L"DirectOutputRegister"
+#define DIRECT_OUTPUT_MASK_VALUE     L"DirectOutputMask"
+
+//
+// Pin write pipelines. Every pin write goes through the same stages:
+// ETW submit, the backend write, cost accounting, ETW completion and the
+// motor model. Only the backend write depends on the configuration, so
+// one writer is generated per backend and the device's writer is chosen
+// whenever its configuration changes; the final stage then carries no
+// backend branch. The stages above it are not specialized: modulation is
+// chosen once per effect rather than per edge, a single motor exists,
+// and ETW sessions attach at run time, so tracing stays an enablement
+// check. The generic writer keeps the run-time backend selection as a
+// reference that calibration times against the selected writer.
+//
+
+FORCEINLINE
+NTSTATUS
+SamsungHapticsPinSetRegister(
+	_In_ PDEVICE_CONTEXT devContext,
+	_In_ UCHAR value
+)
+/*++
+
+Routine Description:
+
+	Flip the TLMM output bit with a read-modify-write of the pin's own
+	register, which costs a few bus cycles rather than a full I/O round
+	trip.
+
+--*/
+{
+	ULONG reg = READ_REGISTER_ULONG(devContext->OutputRegister);
+
+	reg = value ? (reg | devContext->OutputRegisterMask) : (reg & ~devContext->OutputRegisterMask);
+	WRITE_REGISTER_ULONG(devContext->OutputRegister, reg);
+
+	return STATUS_SUCCESS;
+}
+
+FORCEINLINE
 NTSTATUS
-GpioWritePin(
-	IN PDEVICE_CONTEXT devContext,
-	UCHAR value
+SamsungHapticsPinSetIoctl(
+	_In_ PDEVICE_CONTEXT devContext,
+	_In_ UCHAR value,
+	_In_opt_ WDFREQUEST Request
 )
+/*++
+
+Routine Description:
+
+	Send IOCTL_GPIO_WRITE_PINS through GpioClx and the controller driver,
+	reusing the pre-armed request when there is one.
+
+--*/
 {
 	WDF_MEMORY_DESCRIPTOR memDesc;
 	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(&memDesc, &value, sizeof(value));
+
+	if (Request != NULL) {
+		WDF_REQUEST_REUSE_PARAMS reuseParams;
+		WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+		WdfRequestReuse(Request, &reuseParams);
+	}
+
 	return WdfIoTargetSendIoctlSynchronously(
 		devContext->GpioIoTarget,   // Use the GPIO I/O target handle
-		NULL,                       // Optional WDFREQUEST (NULL for synchronous)
+		Request,                    // Preallocated request, or NULL
 		IOCTL_GPIO_WRITE_PINS,
 		&memDesc,                   // Input buffer with our value
 		NULL,                       // No output buffer
@@ -40,6 +109,278 @@ GpioWritePin(
 	);
 }
 
+#define SAMSUNG_HAPTICS_PIN_SET_REGISTER(devContext, value) \
+	SamsungHapticsPinSetRegister((devContext), (value))
+#define SAMSUNG_HAPTICS_PIN_SET_IOCTL(devContext, value) \
+	SamsungHapticsPinSetIoctl((devContext), (value), NULL)
+#define SAMSUNG_HAPTICS_PIN_SET_IOCTL_REUSED(devContext, value) \
+	SamsungHapticsPinSetIoctl((devContext), (value), (devContext)->GpioWriteRequest)
+#define SAMSUNG_HAPTICS_PIN_SET_GENERIC(devContext, value)                 \
+	(((devContext)->OutputBackend == SamsungHapticsOutputBackendRegister) ? \
+		SamsungHapticsPinSetRegister((devContext), (value)) :               \
+		SamsungHapticsPinSetIoctl((devContext), (value), (devContext)->GpioWriteRequest))
+
+#define SAMSUNG_HAPTICS_DEFINE_PIN_WRITER(Name, PinSet)                     \
+	NTSTATUS                                                                \
+	Name(                                                                   \
+		_In_ PDEVICE_CONTEXT devContext,                                    \
+		_In_ UCHAR value                                                    \
+	)                                                                       \
+	{                                                                       \
+		NTSTATUS status;                                                    \
+		LARGE_INTEGER start;                                                \
+		LARGE_INTEGER end;                                                  \
+		PSAMSUNG_HAPTICS_CPU_COUNTERS counters;                             \
+                                                                            \
+		SamsungHapticsEtwPinWriteSubmit(&devContext->Effect.ActivityId, value); \
+                                                                            \
+		start = KeQueryPerformanceCounter(NULL);                            \
+		status = PinSet(devContext, value);                                 \
+		end = KeQueryPerformanceCounter(NULL);                              \
+                                                                            \
+		counters = SamsungHapticsCpuCountersLocal(devContext);              \
+		InterlockedIncrement64(&counters->PinWrites);                       \
+		InterlockedAdd64(&counters->PinWriteTime, end.QuadPart - start.QuadPart); \
+                                                                            \
+		SamsungHapticsEtwPinWriteComplete(&devContext->Effect.ActivityId, value, status); \
+                                                                            \
+		if (NT_SUCCESS(status)) {                                           \
+			devContext->PinLevel = value;                                   \
+			SamsungHapticsMotorModelPinChanged(&devContext->Motor, value);  \
+		}                                                                   \
+                                                                            \
+		return status;                                                      \
+	}
+
+static SAMSUNG_HAPTICS_WRITE_PIN SamsungHapticsWritePinRegister;
+static SAMSUNG_HAPTICS_WRITE_PIN SamsungHapticsWritePinIoctl;
+static SAMSUNG_HAPTICS_WRITE_PIN SamsungHapticsWritePinIoctlReused;
+
+SAMSUNG_HAPTICS_DEFINE_PIN_WRITER(SamsungHapticsWritePinRegister, SAMSUNG_HAPTICS_PIN_SET_REGISTER)
+SAMSUNG_HAPTICS_DEFINE_PIN_WRITER(SamsungHapticsWritePinIoctl, SAMSUNG_HAPTICS_PIN_SET_IOCTL)
+SAMSUNG_HAPTICS_DEFINE_PIN_WRITER(SamsungHapticsWritePinIoctlReused, SAMSUNG_HAPTICS_PIN_SET_IOCTL_REUSED)
+SAMSUNG_HAPTICS_DEFINE_PIN_WRITER(SamsungHapticsWritePinGeneric, SAMSUNG_HAPTICS_PIN_SET_GENERIC)
+
+VOID
+SamsungHapticsOutputSelect(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+
+Routine Description:
+
+	Pick the pin writer for the current backend and request. Called when
+	either changes, with OutputLock held once the device is running.
+
+--*/
+{
+	PFN_SAMSUNG_HAPTICS_WRITE_PIN writer;
+
+	if (devContext->OutputBackend == SamsungHapticsOutputBackendRegister) {
+		writer = SamsungHapticsWritePinRegister;
+	}
+	else if (devContext->GpioWriteRequest != NULL) {
+		writer = SamsungHapticsWritePinIoctlReused;
+	}
+	else {
+		writer = SamsungHapticsWritePinIoctl;
+	}
+
+	devContext->WritePin = writer;
+}
+
+NTSTATUS
+SamsungHapticsDirectOutputInitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+
+Routine Description:
+
+	Map the TLMM output register of the enable pin if the device hardware
+	key asks for the direct backend. The register address and output bit
+	are board specific, so they come from configuration rather than from
+	the ACPI resources. Any missing or invalid value keeps the IOCTL
+	backend.
+
+Return Value:
+
+	STATUS_SUCCESS in all cases but mapping failures of a configured
+	register.
+
+--*/
+{
+	NTSTATUS status;
+	WDFKEY key;
+	ULONG enable = 0;
+	ULONG mask = 0;
+	ULONG valueType = 0;
+	ULONG valueLength = 0;
+	PHYSICAL_ADDRESS address;
+	DECLARE_CONST_UNICODE_STRING(enableName, DIRECT_OUTPUT_ENABLE_VALUE);
+	DECLARE_CONST_UNICODE_STRING(registerName, DIRECT_OUTPUT_REGISTER_VALUE);
+	DECLARE_CONST_UNICODE_STRING(maskName, DIRECT_OUTPUT_MASK_VALUE);
+
+	PAGED_CODE();
+
+	devContext->OutputBackend = SamsungHapticsOutputBackendIoctl;
+	devContext->OutputRegister = NULL;
+	SamsungHapticsOutputSelect(devContext);
+	address.QuadPart = 0;
+
+	status = WdfDeviceOpenRegistryKey(
+		devContext->Device,
+		PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&key);
+	if (!NT_SUCCESS(status)) {
+		return STATUS_SUCCESS;
+	}
+
+	if (!NT_SUCCESS(WdfRegistryQueryULong(key, &enableName, &enable)) || enable == 0) {
+		goto exit;
+	}
+
+	status = WdfRegistryQueryValue(
+		key,
+		&registerName,
+		sizeof(address.QuadPart),
+		&address.QuadPart,
+		&valueLength,
+		&valueType);
+	if (!NT_SUCCESS(status) || valueType != REG_QWORD || address.QuadPart == 0 ||
+		!NT_SUCCESS(WdfRegistryQueryULong(key, &maskName, &mask)) || mask == 0) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_INIT, "Direct output enabled but not configured, using GpioClx");
+		goto exit;
+	}
+
+	devContext->OutputRegister = (volatile ULONG*)MmMapIoSpaceEx(
+		address,
+		sizeof(ULONG),
+		PAGE_READWRITE | PAGE_NOCACHE);
+	if (devContext->OutputRegister == NULL) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "MmMapIoSpaceEx failed for %I64x", address.QuadPart);
+		WdfRegistryClose(key);
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	devContext->OutputRegisterMask = mask;
+	devContext->OutputBackend = SamsungHapticsOutputBackendRegister;
+	SamsungHapticsOutputSelect(devContext);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_INIT,
+		"Direct output backend: register %I64x mask %08x",
+		address.QuadPart,
+		mask);
+
+exit:
+	WdfRegistryClose(key);
+	return STATUS_SUCCESS;
+}
+
+VOID
+SamsungHapticsDirectOutputUninitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PAGED_CODE();
+
+	devContext->OutputBackend = SamsungHapticsOutputBackendIoctl;
+	SamsungHapticsOutputSelect(devContext);
+
+	if (devContext->OutputRegister != NULL) {
+		MmUnmapIoSpace((PVOID)devContext->OutputRegister, sizeof(ULONG));
+		devContext->OutputRegister = NULL;
+	}
+}
+
+VOID
+SamsungHapticsOutputQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_OUTPUT_STATISTICS Statistics
+)
+{
+	LARGE_INTEGER frequency;
+	SAMSUNG_HAPTICS_CPU_COUNTERS total;
+
+	KeQueryPerformanceCounter(&frequency);
+	SamsungHapticsCpuCountersSum(devContext, &total);
+
+	Statistics->Backend = devContext->OutputBackend;
+	Statistics->Reserved = 0;
+	Statistics->PinWrites = (ULONGLONG)total.PinWrites;
+	Statistics->PinWriteTimeNs = SamsungHapticsTicksToNs((ULONGLONG)total.PinWriteTime, (ULONGLONG)frequency.QuadPart);
+}
+
+NTSTATUS
+SamsungHapticsCpuCountersInitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+
+Routine Description:
+
+	Allocate one cache-aligned counter slot per processor the system can
+	ever have, so hot-added processors need no resizing.
+
+--*/
+{
+	ULONG slots;
+
+	PAGED_CODE();
+
+	slots = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+
+	devContext->CpuCounters = (PSAMSUNG_HAPTICS_CPU_COUNTERS)ExAllocatePool2(
+		POOL_FLAG_NON_PAGED | POOL_FLAG_CACHE_ALIGNED,
+		(SIZE_T)slots * sizeof(SAMSUNG_HAPTICS_CPU_COUNTERS),
+		HAPTICS_POOL_TAG);
+	if (devContext->CpuCounters == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	devContext->CpuCounterSlots = slots;
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+SamsungHapticsCpuCountersUninitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PAGED_CODE();
+
+	if (devContext->CpuCounters != NULL) {
+		ExFreePoolWithTag(devContext->CpuCounters, HAPTICS_POOL_TAG);
+		devContext->CpuCounters = NULL;
+		devContext->CpuCounterSlots = 0;
+	}
+}
+
+VOID
+SamsungHapticsCpuCountersSum(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_CPU_COUNTERS Total
+)
+{
+	ULONG i;
+
+	RtlZeroMemory(Total, sizeof(*Total));
+
+	for (i = 0; i < devContext->CpuCounterSlots; i++) {
+		PSAMSUNG_HAPTICS_CPU_COUNTERS slot = &devContext->CpuCounters[i];
+
+		Total->PinWrites += ReadNoFence64(&slot->PinWrites);
+		Total->PinWriteTime += ReadNoFence64(&slot->PinWriteTime);
+		Total->SetStateCalls += ReadNoFence64(&slot->SetStateCalls);
+		Total->GetStateCalls += ReadNoFence64(&slot->GetStateCalls);
+	}
+}
+
 NTSTATUS
 SamsungHapticsCreateDevice(
 	_Inout_ WDFDRIVER Driver,
@@ -117,3 +458,55 @@ Return Value:
 
 	return status;
 }
+
+VOID
+SamsungHapticsPowerQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_POWER_STATISTICS Statistics
+)
+{
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+	*Statistics = devContext->Power;
+	WdfWaitLockRelease(devContext->OutputLock);
+}
+
+ULONGLONG
+SamsungHapticsElapsedUs(
+	_In_ LARGE_INTEGER Start
+)
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER end = KeQueryPerformanceCounter(&frequency);
+
+	return (ULONGLONG)(end.QuadPart - Start.QuadPart) * 1000000 / (ULONGLONG)frequency.QuadPart;
+}
+
+ULONGLONG
+SamsungHapticsTicksToNs(
+	_In_ ULONGLONG Ticks,
+	_In_ ULONGLONG Frequency
+)
+/*++
+Routine Description:
+
+	Convert performance counter ticks to nanoseconds. Whole seconds are
+	scaled separately from the remainder, so long accumulated totals do
+	not overflow.
+
+--*/
+{
+	return (Ticks / Frequency) * 1000000000ULL + (Ticks % Frequency) * 1000000000ULL / Frequency;
+}
+
+VOID
+SamsungHapticsLatencyAdd(
+	_Inout_ PSAMSUNG_HAPTICS_LATENCY Latency,
+	_In_ ULONGLONG LatencyUs
+)
+{
+	Latency->Count++;
+	Latency->TotalUs += LatencyUs;
+	Latency->MaxUs = max(Latency->MaxUs, (ULONG)min(LatencyUs, MAXULONG));
+}
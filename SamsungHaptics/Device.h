@@ -20,6 +20,18 @@ Environment:
 #pragma once
 #include <hwnclx.h>
 #include <hwn.h>
+#include "audio.h"
+#include "modulator.h"
+#include "motor.h"
+#include "profile.h"
+#include "effect.h"
+#include "mixer.h"
+#include "library.h"
+#include "schedule.h"
+#include "prearm.h"
+#include "recorder.h"
+#include "calibration.h"
+#include "stream.h"
 
 EXTERN_C_START
 
@@ -31,12 +43,50 @@ typedef struct _SAMSUNG_HAPTICS_CURRENT_STATE
 	struct _SAMSUNG_HAPTICS_CURRENT_STATE* NextState;
 } SAMSUNG_HAPTICS_CURRENT_STATE, * PSAMSUNG_HAPTICS_CURRENT_STATE;
 
+//
+// Counters bumped on every pin write or HwN callback. Each processor owns
+// a cache line of them so concurrent callers never write the same line;
+// queries sum the slots.
+//
+typedef struct DECLSPEC_CACHEALIGN _SAMSUNG_HAPTICS_CPU_COUNTERS
+{
+	LONG64 PinWrites;
+	LONG64 PinWriteTime;       // performance counter ticks
+	LONG64 SetStateCalls;
+	LONG64 GetStateCalls;
+} SAMSUNG_HAPTICS_CPU_COUNTERS, * PSAMSUNG_HAPTICS_CPU_COUNTERS;
+
+struct _DEVICE_CONTEXT;
+
+//
+// Drives the enable pin through one specialized output pipeline
+//
+typedef
+NTSTATUS
+SAMSUNG_HAPTICS_WRITE_PIN(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ UCHAR value
+);
+
+typedef SAMSUNG_HAPTICS_WRITE_PIN* PFN_SAMSUNG_HAPTICS_WRITE_PIN;
+
 //
 // The device context performs the same job as
 // a WDM device extension in the driver frameworks
 //
+// Fields are grouped by who writes them: configuration set up once, HwN
+// callback state, output state under OutputLock, the audio envelope, and
+// the recorder under its own lock. The framework only guarantees
+// MEMORY_ALLOCATION_ALIGNMENT for the context, so no member is cache
+// aligned here; the counters with the most concurrent traffic live in a
+// separately allocated, cache-aligned per-processor block instead.
+//
 typedef struct _DEVICE_CONTEXT
 {
+	//
+	// --- Configuration, written during setup only ---
+	//
+
 	//
 	// Device handle
 	//
@@ -53,13 +103,137 @@ typedef struct _DEVICE_CONTEXT
 	//
 	WDFIOTARGET GpioIoTarget;
 
+	//
+	// Optional direct register backend for the enable pin. The GPIO I/O
+	// target stays open so GpioClx keeps the pin reserved and configured.
+	//
+	SAMSUNG_HAPTICS_OUTPUT_BACKEND OutputBackend;
+	volatile ULONG* OutputRegister;
+	ULONG           OutputRegisterMask;
+
 	//
 	// Number of vibration motors
 	//
 	USHORT NumberOfHapticsDevices;
 
+	//
+	// Per-processor counters, one slot per possible processor
+	//
+	PSAMSUNG_HAPTICS_CPU_COUNTERS CpuCounters;
+	ULONG                         CpuCounterSlots;
+
+	//
+	// Slot in the driver-wide device registry, and the rundown protection
+	// that keeps this context alive while a registry lookup is using it
+	//
+	ULONG          RegistryIndex;
+	EX_RUNDOWN_REF RegistryRundown;
+
+	//
+	// Whether this device holds a reference on the control device
+	//
+	BOOLEAN ControlReferenced;
+
+	//
+	// Whether the tuning profile and effect library have been read. They
+	// are read on the first start, and afterwards only on request.
+	//
+	BOOLEAN TuningLoaded;
+
+	//
+	// --- HwN callbacks ---
+	//
+	// Cached HwN state, and how often callbacks overlap
+	//
 	PSAMSUNG_HAPTICS_CURRENT_STATE CurrentStates;
 	HWN_STATE PreviousState;
+	SAMSUNG_HAPTICS_CONCURRENCY_STATISTICS Concurrency;
+
+	//
+	// Bumped by every callback on entry
+	//
+	volatile LONG CallbacksInFlight;
+
+	//
+	// --- Output path, under OutputLock ---
+	//
+	// Serializes every write to the enable pin, and the level it was last
+	// driven to
+	//
+	WDFWAITLOCK OutputLock;
+	UCHAR       PinLevel;
+
+	//
+	// Pin writer specialized for the backend and request in use
+	//
+	PFN_SAMSUNG_HAPTICS_WRITE_PIN WritePin;
+
+	//
+	// Set outside D0 (under OutputLock): requests are cached in the mixer
+	// but the pin stays low and no output timer is armed
+	//
+	BOOLEAN Stopped;
+
+	//
+	// Reusable request for pin writes, created on first pre-arm
+	//
+	WDFREQUEST GpioWriteRequest;
+
+	//
+	// Active tuning profile (immutable, swapped under OutputLock) and the
+	// effect it is applied to
+	//
+	PCSAMSUNG_HAPTICS_PROFILE    Profile;
+	SAMSUNG_HAPTICS_EFFECT_STATE Effect;
+
+	//
+	// Voices of overlapping effects, mixed into Effect
+	//
+	SAMSUNG_HAPTICS_MIXER Mixer;
+
+	//
+	// Intensity modulator driving the enable pin
+	//
+	SAMSUNG_HAPTICS_MODULATOR Modulator;
+
+	//
+	// ERM model fed with every pin edge, for quality estimates
+	//
+	SAMSUNG_HAPTICS_MOTOR_MODEL Motor;
+
+	//
+	// Measured pin write cost, compensated on timed edges
+	//
+	SAMSUNG_HAPTICS_CALIBRATION_STATE Calibration;
+
+	//
+	// Pre-arm lease and cold effect latency
+	//
+	SAMSUNG_HAPTICS_PREARM_STATE Prearm;
+
+	//
+	// Preloaded effects HwN requests can play by id
+	//
+	SAMSUNG_HAPTICS_LIBRARY_STATE Library;
+	SAMSUNG_HAPTICS_SCHEDULE_CACHE ScheduleCache;
+
+	//
+	// Shared-memory intensity stream polled by the effect timer
+	//
+	SAMSUNG_HAPTICS_STREAM_STATE Stream;
+
+	SAMSUNG_HAPTICS_POWER_STATISTICS Power;
+
+	//
+	// --- Audio-to-haptics envelope state, written by the submitting
+	// thread ---
+	//
+	SAMSUNG_HAPTICS_AUDIO_STATE Audio;
+
+	//
+	// --- Capture of HwN callbacks for offline analysis and replay ---
+	//
+	SAMSUNG_HAPTICS_RECORDER Recorder;
 } DEVICE_CONTEXT, * PDEVICE_CONTEXT;
 
 //
@@ -78,9 +252,104 @@ SamsungHapticsCreateDevice(
 	_Inout_ PWDFDEVICE_INIT DeviceInit
 );
 
-NTSTATUS GpioWritePin(
+FORCEINLINE
+NTSTATUS
+GpioWritePin(
 	IN PDEVICE_CONTEXT devContext,
 	UCHAR value
+)
+/*++
+
+Routine Description:
+
+	Drive the enable pin. Must be called with OutputLock held.
+
+--*/
+{
+	return devContext->WritePin(devContext, value);
+}
+
+VOID
+SamsungHapticsOutputSelect(
+	_Inout_ PDEVICE_CONTEXT devContext
+);
+
+//
+// Pin writer choosing the backend on every write, kept as the reference
+// the specialized writers are measured against
+//
+SAMSUNG_HAPTICS_WRITE_PIN SamsungHapticsWritePinGeneric;
+
+NTSTATUS
+SamsungHapticsDirectOutputInitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+);
+
+VOID
+SamsungHapticsDirectOutputUninitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+);
+
+VOID
+SamsungHapticsPowerQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_POWER_STATISTICS Statistics
+);
+
+NTSTATUS
+SamsungHapticsCpuCountersInitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+);
+
+VOID
+SamsungHapticsCpuCountersUninitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+);
+
+VOID
+SamsungHapticsCpuCountersSum(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_CPU_COUNTERS Total
+);
+
+FORCEINLINE
+PSAMSUNG_HAPTICS_CPU_COUNTERS
+SamsungHapticsCpuCountersLocal(
+	_In_ PDEVICE_CONTEXT devContext
+)
+{
+	//
+	// The caller may migrate after the lookup, so slots are still updated
+	// with interlocked operations; they just no longer bounce between
+	// processors.
+	//
+	return &devContext->CpuCounters[min(KeGetCurrentProcessorIndex(), devContext->CpuCounterSlots - 1)];
+}
+
+VOID
+SamsungHapticsOutputQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_OUTPUT_STATISTICS Statistics
+);
+
+//
+// Latency accounting, in microseconds of the performance counter
+//
+ULONGLONG
+SamsungHapticsElapsedUs(
+	_In_ LARGE_INTEGER Start
+);
+
+ULONGLONG
+SamsungHapticsTicksToNs(
+	_In_ ULONGLONG Ticks,
+	_In_ ULONGLONG Frequency
+);
+
+VOID
+SamsungHapticsLatencyAdd(
+	_Inout_ PSAMSUNG_HAPTICS_LATENCY Latency,
+	_In_ ULONGLONG LatencyUs
 );
 
 EXTERN_C_END
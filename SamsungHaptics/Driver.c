@@ -24,8 +24,18 @@ Environment:
 #pragma alloc_text (INIT, DriverEntry)
 #pragma alloc_text (PAGE, SamsungHapticsEvtDriverUnload)
 #pragma alloc_text (PAGE, SamsungHapticsEvtDriverContextCleanup)
+#pragma alloc_text (PAGE, SamsungHapticsUnregisterDeviceContext)
 #endif
 
+//
+// Registry of the device contexts owned by this driver. Slots are claimed,
+// released and looked up under the registry lock; a lookup takes rundown
+// protection on the context before dropping the lock, so a context cannot
+// be released between being found and being referenced.
+//
+static KSPIN_LOCK SamsungHapticsDeviceRegistryLock;
+static PDEVICE_CONTEXT SamsungHapticsDeviceRegistry[SAMSUNG_HAPTICS_MAX_DEVICES];
+
 NTSTATUS
 DriverEntry(
 	_In_ PDRIVER_OBJECT  DriverObject,
@@ -70,6 +80,17 @@ Return Value:
 
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+	KeInitializeSpinLock(&SamsungHapticsDeviceRegistryLock);
+
+	//
+	// Register the TraceLogging provider used for request correlation.
+	// Tracing is optional, so a failure here is not fatal.
+	//
+	status = SamsungHapticsEtwRegister();
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_DRIVER, "SamsungHapticsEtwRegister failed %!STATUS!", status);
+	}
+
 	WDF_DRIVER_CONFIG_INIT(&config, SamsungHapticsEvtDeviceAdd);
 	config.EvtDriverUnload = SamsungHapticsEvtDriverUnload;
 	config.DriverPoolTag = HAPTICS_POOL_TAG;
@@ -90,6 +111,7 @@ Return Value:
 
 	if (!NT_SUCCESS(status)) {
 		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDriverCreate failed %!STATUS!", status);
+		SamsungHapticsEtwUnregister();
 		WPP_CLEANUP(DriverObject);
 		return status;
 	}
@@ -118,6 +140,21 @@ Return Value:
 		return status;
 	}
 
+	//
+	// Battery saver scaling can still be forced from the control device
+	// if the power setting cannot be followed.
+	//
+	status = SamsungHapticsSaverInitialize();
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_DRIVER, "SamsungHapticsSaverInitialize failed %!STATUS!", status);
+		status = STATUS_SUCCESS;
+	}
+
+	//
+	// The control device is created with the first SECHWN device.
+	//
+	SamsungHapticsControlInitialize();
+
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit");
 
 	return status;
@@ -183,6 +220,8 @@ Return Value:
 
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+	SamsungHapticsEtwUnregister();
+
 	//
 	// Stop WPP Tracing
 	//
@@ -210,6 +249,8 @@ Return Value:
 {
 	PAGED_CODE();
 
+	SamsungHapticsSaverUninitialize();
+
 	//
 	// Unregister HwnHaptics client driver here
 	//
@@ -221,4 +262,156 @@ Return Value:
 	WPP_CLEANUP(WdfDriverWdmGetDriverObject(Driver));
 
 	return;
-}
\ No newline at end of file
+}
+
+NTSTATUS
+SamsungHapticsRegisterDeviceContext(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Publish a device context in the first free slot of the driver-wide
+	registry.
+
+Arguments:
+
+	devContext - the device context to publish.
+
+Return Value:
+
+	STATUS_SUCCESS if a slot was claimed,
+	STATUS_INSUFFICIENT_RESOURCES if every slot is in use.
+
+--*/
+{
+	KIRQL irql;
+	ULONG i;
+
+	ExInitializeRundownProtection(&devContext->RegistryRundown);
+	devContext->RegistryIndex = SAMSUNG_HAPTICS_INVALID_REGISTRY_INDEX;
+
+	KeAcquireSpinLock(&SamsungHapticsDeviceRegistryLock, &irql);
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MAX_DEVICES; i++)
+	{
+		if (SamsungHapticsDeviceRegistry[i] == NULL)
+		{
+			SamsungHapticsDeviceRegistry[i] = devContext;
+			devContext->RegistryIndex = i;
+			break;
+		}
+	}
+
+	KeReleaseSpinLock(&SamsungHapticsDeviceRegistryLock, irql);
+
+	if (devContext->RegistryIndex == SAMSUNG_HAPTICS_INVALID_REGISTRY_INDEX)
+	{
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Device registry is full");
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Device context %p registered in slot %u", devContext, devContext->RegistryIndex);
+	return STATUS_SUCCESS;
+}
+
+VOID
+SamsungHapticsUnregisterDeviceContext(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Remove a device context from the registry and wait for every outstanding
+	registry reference to be dropped.
+
+Arguments:
+
+	devContext - the device context to remove.
+
+Return Value:
+
+	VOID.
+
+--*/
+{
+	ULONG index = devContext->RegistryIndex;
+	KIRQL irql;
+
+	PAGED_CODE();
+
+	if (index >= SAMSUNG_HAPTICS_MAX_DEVICES)
+	{
+		return;
+	}
+
+	KeAcquireSpinLock(&SamsungHapticsDeviceRegistryLock, &irql);
+	if (SamsungHapticsDeviceRegistry[index] == devContext)
+	{
+		SamsungHapticsDeviceRegistry[index] = NULL;
+	}
+	KeReleaseSpinLock(&SamsungHapticsDeviceRegistryLock, irql);
+
+	//
+	// No lookup can find the context any more; stop a replay holding it
+	// and wait for the ones that did.
+	//
+	SamsungHapticsRecorderAbort(&devContext->Recorder);
+	ExWaitForRundownProtectionRelease(&devContext->RegistryRundown);
+	devContext->RegistryIndex = SAMSUNG_HAPTICS_INVALID_REGISTRY_INDEX;
+}
+
+PDEVICE_CONTEXT
+SamsungHapticsReferenceDeviceContext(
+	_In_ ULONG Index
+)
+/*++
+Routine Description:
+
+	Look up the device context registered in a slot. Callable at
+	IRQL <= DISPATCH_LEVEL.
+
+Arguments:
+
+	Index - registry slot to look up.
+
+Return Value:
+
+	The referenced device context, or NULL if the slot is empty or the
+	device is being removed. A non-NULL result must be released with
+	SamsungHapticsDereferenceDeviceContext.
+
+--*/
+{
+	PDEVICE_CONTEXT devContext;
+	KIRQL irql;
+
+	if (Index >= SAMSUNG_HAPTICS_MAX_DEVICES)
+	{
+		return NULL;
+	}
+
+	//
+	// The context stays in its slot, and so stays allocated, for as long as
+	// the lock is held: take the reference before dropping it.
+	//
+	KeAcquireSpinLock(&SamsungHapticsDeviceRegistryLock, &irql);
+
+	devContext = SamsungHapticsDeviceRegistry[Index];
+	if (devContext != NULL && !ExAcquireRundownProtection(&devContext->RegistryRundown))
+	{
+		devContext = NULL;
+	}
+
+	KeReleaseSpinLock(&SamsungHapticsDeviceRegistryLock, irql);
+
+	return devContext;
+}
+
+VOID
+SamsungHapticsDereferenceDeviceContext(
+	_In_ PDEVICE_CONTEXT devContext
+)
+{
+	ExReleaseRundownProtection(&devContext->RegistryRundown);
+}
@@ -28,6 +28,8 @@ Environment:
 #include <reshub.h>
 #include "device.h"
 #include "trace.h"
+#include "etw.h"
+#include "control.h"
 
 EXTERN_C_START
 
@@ -47,4 +49,35 @@ HWN_CLIENT_STOP_DEVICE SamsungHapticsStopDevice;
 HWN_CLIENT_SET_STATE SamsungHapticsSetState;
 HWN_CLIENT_GET_STATE SamsungHapticsGetState;
 
+//
+// Driver-wide registry of device contexts. Each SECHWN instance keeps its
+// state in its own context; the registry lets driver-wide code (the control
+// device, diagnostics) find the instances. Slots change under a spin lock.
+// SamsungHapticsReferenceDeviceContext returns a context with rundown
+// protection held, which SamsungHapticsDereferenceDeviceContext drops, and
+// unregistering waits for every such reference to be dropped.
+//
+#define SAMSUNG_HAPTICS_MAX_DEVICES 8
+#define SAMSUNG_HAPTICS_INVALID_REGISTRY_INDEX ((ULONG)-1)
+
+NTSTATUS
+SamsungHapticsRegisterDeviceContext(
+	_Inout_ PDEVICE_CONTEXT devContext
+);
+
+VOID
+SamsungHapticsUnregisterDeviceContext(
+	_Inout_ PDEVICE_CONTEXT devContext
+);
+
+PDEVICE_CONTEXT
+SamsungHapticsReferenceDeviceContext(
+	_In_ ULONG Index
+);
+
+VOID
+SamsungHapticsDereferenceDeviceContext(
+	_In_ PDEVICE_CONTEXT devContext
+);
+
 EXTERN_C_END
@@ -0,0 +1,437 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Effect.c - Effect lifetime on a motor
+
+Abstract:
+
+	Applies the device's tuning profile to ON/OFF requests:
+
+	- the requested intensity goes through the profile's intensity curve,
+	- a modulated effect may start with a full-drive kick to overcome the
+	  rotor's static friction,
+	- an OFF arriving before the minimum pulse has elapsed is deferred,
+	- an effect is cut off once it exceeds the maximum ON time,
+	- while battery saver scaling is active, the intensity is scaled and
+	  the maximum ON time is capped by the saver's pulse limit.
+
+	The same timer also retires timed mixer voices, ends pre-arm leases
+	and polls the shared-memory intensity stream. It fires ahead of each
+	deadline by the calibrated pin write cost, so the edge lands on the
+	deadline rather than after it. Deadlines are served by one output
+	timer per device, whose callback runs at PASSIVE_LEVEL since ending a
+	kick or an effect writes the pin. All routines run with OutputLock
+	held.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "effect.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsEffectInitialize)
+#pragma alloc_text (PAGE, SamsungHapticsEffectUninitialize)
+#endif
+
+#define EFFECT_MS_TO_INTERRUPT_TIME(ms) ((ULONGLONG)(ms) * 10000)
+
+SAMSUNG_HAPTICS_TIMER_CALLBACK SamsungHapticsEffectTimerCallback;
+
+static
+BOOLEAN
+SamsungHapticsEffectIsModulated(
+	_In_ PDEVICE_CONTEXT devContext,
+	_In_ ULONG Intensity
+)
+{
+	return devContext->Modulator.Modulation != SamsungHapticsModulationNone &&
+		Intensity < SAMSUNG_HAPTICS_MAX_INTENSITY;
+}
+
+static
+VOID
+SamsungHapticsEffectArmTimer(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONGLONG Now
+)
+/*++
+Routine Description:
+
+	Program the effect timer for the earliest pending deadline, or stop it
+	when nothing is pending.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_EFFECT_STATE effect = &devContext->Effect;
+	ULONGLONG deadline = MAXULONG64;
+
+	if (devContext->Stopped) {
+		SamsungHapticsTimerCancel(&effect->Timer);
+		return;
+	}
+
+	if (effect->KickEnd != 0) {
+		deadline = min(deadline, effect->KickEnd);
+	}
+	if (effect->OffDeadline != 0) {
+		deadline = min(deadline, effect->OffDeadline);
+	}
+	if (effect->OnTimeLimit != 0) {
+		deadline = min(deadline, effect->OnTimeLimit);
+	}
+	if (devContext->Mixer.NextEnd != 0) {
+		deadline = min(deadline, devContext->Mixer.NextEnd);
+	}
+	if (devContext->Prearm.LeaseEnd != 0) {
+		deadline = min(deadline, devContext->Prearm.LeaseEnd);
+	}
+	if (devContext->Stream.NextPoll != 0) {
+		deadline = min(deadline, devContext->Stream.NextPoll);
+	}
+
+	if (deadline == MAXULONG64) {
+		SamsungHapticsTimerCancel(&effect->Timer);
+		return;
+	}
+
+	Now += devContext->Calibration.Lead;
+	SamsungHapticsTimerSet(&effect->Timer, (LONGLONG)max(deadline - min(deadline, Now), 1), 0);
+}
+
+static
+NTSTATUS
+SamsungHapticsEffectDrive(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONG Intensity
+)
+/*++
+Routine Description:
+
+	Drive the pin for an output intensity: modulated if the modulator takes
+	it, fully on otherwise.
+
+--*/
+{
+	if (SamsungHapticsModulatorStart(devContext, Intensity)) {
+		return STATUS_SUCCESS;
+	}
+
+	return GpioWritePin(devContext, 1);  // drive GPIO high
+}
+
+static
+VOID
+SamsungHapticsEffectAccount(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONGLONG Now
+)
+/*++
+Routine Description:
+
+	Close the current intensity segment, crediting the saver with the
+	full-drive equivalent of the intensity it took off a modulated effect.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_EFFECT_STATE effect = &devContext->Effect;
+
+	if (effect->Active &&
+		effect->Unscaled > effect->Intensity &&
+		SamsungHapticsEffectIsModulated(devContext, effect->Intensity))
+	{
+		effect->Saver.ScaledTime +=
+			(Now - effect->SegmentStart) * (effect->Unscaled - effect->Intensity) / SAMSUNG_HAPTICS_MAX_INTENSITY;
+	}
+
+	effect->SegmentStart = Now;
+}
+
+static
+VOID
+SamsungHapticsEffectCloseTruncation(
+	_Inout_ PSAMSUNG_HAPTICS_EFFECT_STATE Effect,
+	_In_ ULONGLONG Now
+)
+{
+	if (Effect->TruncatedAt != 0) {
+		Effect->Saver.TruncatedTime += Now - Effect->TruncatedAt;
+		Effect->TruncatedAt = 0;
+	}
+}
+
+static
+VOID
+SamsungHapticsEffectAdoptActivity(
+	_Inout_ PSAMSUNG_HAPTICS_EFFECT_STATE Effect
+)
+/*++
+Routine Description:
+
+	Attribute the effect to the SetState request changing it, if any. An
+	effect started by anything else carries no activity; one already
+	running keeps the activity of the request that last changed it.
+
+--*/
+{
+	if (Effect->Request != NULL) {
+		Effect->ActivityId = *Effect->Request;
+	}
+	else if (!Effect->Active) {
+		RtlZeroMemory(&Effect->ActivityId, sizeof(Effect->ActivityId));
+	}
+}
+
+static
+NTSTATUS
+SamsungHapticsEffectEnd(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PSAMSUNG_HAPTICS_EFFECT_STATE effect = &devContext->Effect;
+	NTSTATUS status;
+	BOOLEAN wasActive = effect->Active;
+
+	SamsungHapticsEffectAccount(devContext, KeQueryInterruptTime());
+
+	effect->Active = FALSE;
+	effect->EndTime = KeQueryInterruptTime();
+	effect->KickEnd = 0;
+	effect->OffDeadline = 0;
+	effect->OnTimeLimit = 0;
+
+	SamsungHapticsModulatorStop(devContext);
+	status = GpioWritePin(devContext, 0);  // drive GPIO low
+
+	if (wasActive) {
+		SamsungHapticsMotorModelEffectEnd(&devContext->Motor);
+		SamsungHapticsEtwEffectEnd(&effect->ActivityId, 0);
+		RtlZeroMemory(&effect->ActivityId, sizeof(effect->ActivityId));
+	}
+
+	return status;
+}
+
+NTSTATUS
+SamsungHapticsEffectOn(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONG Intensity
+)
+{
+	PSAMSUNG_HAPTICS_EFFECT_STATE effect = &devContext->Effect;
+	PCSAMSUNG_HAPTICS_PROFILE profile = devContext->Profile;
+	ULONGLONG now = KeQueryInterruptTime();
+	LONG saver = ReadNoFence(&SamsungHapticsSaverParameters);
+	ULONG unscaled = SamsungHapticsProfileMapIntensity(profile, Intensity);
+	ULONG output = unscaled;
+	NTSTATUS status;
+
+	if (output != 0) {
+		output = max(output * SamsungHapticsSaverScalePercent(saver) / SAMSUNG_HAPTICS_MAX_INTENSITY, 1);
+	}
+
+	SamsungHapticsEffectAccount(devContext, now);
+	SamsungHapticsEffectAdoptActivity(effect);
+
+	effect->OffDeadline = 0;
+	effect->Intensity = output;
+	effect->Unscaled = unscaled;
+
+	if (!effect->Active) {
+		ULONG maxOnTimeMs = profile->MaxOnTimeMs;
+		ULONG maxPulseMs = SamsungHapticsSaverMaxPulseMs(saver);
+
+		effect->SaverLimited = (maxPulseMs != 0 && (maxOnTimeMs == 0 || maxPulseMs < maxOnTimeMs));
+		if (effect->SaverLimited) {
+			maxOnTimeMs = maxPulseMs;
+		}
+
+		SamsungHapticsEffectCloseTruncation(effect, now);
+
+		effect->Active = TRUE;
+		effect->StartTime = now;
+		effect->OnTimeLimit = (maxOnTimeMs != 0) ?
+			now + EFFECT_MS_TO_INTERRUPT_TIME(maxOnTimeMs) : 0;
+
+		SamsungHapticsEtwEffectStart(&effect->ActivityId, 0, output);
+		SamsungHapticsMotorModelEffectStart(&devContext->Motor);
+
+		if (profile->KickMs != 0 && SamsungHapticsEffectIsModulated(devContext, output)) {
+			effect->KickEnd = now + EFFECT_MS_TO_INTERRUPT_TIME(profile->KickMs);
+		}
+	}
+
+	if (effect->KickEnd != 0 && SamsungHapticsEffectIsModulated(devContext, output)) {
+		//
+		// Still kicking: stay fully on, the timer hands over to the
+		// modulator.
+		//
+		SamsungHapticsModulatorStop(devContext);
+		status = GpioWritePin(devContext, 1);
+	}
+	else {
+		effect->KickEnd = 0;
+		status = SamsungHapticsEffectDrive(devContext, output);
+	}
+
+	SamsungHapticsEffectArmTimer(devContext, now);
+
+	return status;
+}
+
+NTSTATUS
+SamsungHapticsEffectOff(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PSAMSUNG_HAPTICS_EFFECT_STATE effect = &devContext->Effect;
+	PCSAMSUNG_HAPTICS_PROFILE profile = devContext->Profile;
+	ULONGLONG now = KeQueryInterruptTime();
+	NTSTATUS status = STATUS_SUCCESS;
+
+	SamsungHapticsEffectCloseTruncation(effect, now);
+
+	if (effect->Active) {
+		SamsungHapticsEffectAdoptActivity(effect);
+	}
+
+	if (effect->Active && profile->MinimumPulseMs != 0) {
+		ULONGLONG earliest = effect->StartTime + EFFECT_MS_TO_INTERRUPT_TIME(profile->MinimumPulseMs);
+
+		if (now < earliest) {
+			//
+			// Too short to be felt: keep driving until the minimum pulse
+			// has elapsed.
+			//
+			effect->OffDeadline = earliest;
+			SamsungHapticsEffectArmTimer(devContext, now);
+			return STATUS_SUCCESS;
+		}
+	}
+
+	status = SamsungHapticsEffectEnd(devContext);
+	SamsungHapticsEffectArmTimer(devContext, now);
+
+	return status;
+}
+
+VOID
+SamsungHapticsEffectQuiesce(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	End the effect at once, ignoring the minimum pulse, drive the pin low
+	and disarm the timer. Must be called with OutputLock held.
+
+--*/
+{
+	SamsungHapticsEffectEnd(devContext);
+	SamsungHapticsTimerCancel(&devContext->Effect.Timer);
+}
+
+VOID
+SamsungHapticsEffectReschedule(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Re-program the timer after a deadline owned by another module changed.
+	Must be called with OutputLock held.
+
+--*/
+{
+	SamsungHapticsEffectArmTimer(devContext, KeQueryInterruptTime());
+}
+
+VOID
+SamsungHapticsEffectTimerCallback(
+	_In_ PVOID Context
+)
+{
+	PDEVICE_CONTEXT devContext = (PDEVICE_CONTEXT)Context;
+	PSAMSUNG_HAPTICS_EFFECT_STATE effect = &devContext->Effect;
+	ULONGLONG now;
+	ULONGLONG edge;
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	now = KeQueryInterruptTime();
+
+	//
+	// A pin write issued now lands after the calibrated lead.
+	//
+	edge = now + devContext->Calibration.Lead;
+
+	if (effect->Active) {
+		if (effect->OffDeadline != 0 && edge >= effect->OffDeadline) {
+			SamsungHapticsEffectEnd(devContext);
+		}
+		else if (effect->OnTimeLimit != 0 && edge >= effect->OnTimeLimit) {
+			if (effect->SaverLimited) {
+				//
+				// The requester still wants the motor on; the time until
+				// it turns it off is saved.
+				//
+				effect->Saver.Truncations++;
+				SamsungHapticsEffectEnd(devContext);
+				effect->TruncatedAt = now;
+			}
+			else {
+				Trace(TRACE_LEVEL_WARNING, TRACE_HAPTICS, "Effect exceeded the maximum ON time, stopping");
+				SamsungHapticsEffectEnd(devContext);
+			}
+		}
+		else if (effect->KickEnd != 0 && edge >= effect->KickEnd) {
+			effect->KickEnd = 0;
+			SamsungHapticsEffectDrive(devContext, effect->Intensity);
+		}
+	}
+
+	if (devContext->Mixer.NextEnd != 0 && edge >= devContext->Mixer.NextEnd) {
+		SamsungHapticsMixerExpire(devContext, edge);
+	}
+
+	if (devContext->Stream.NextPoll != 0 && edge >= devContext->Stream.NextPoll) {
+		SamsungHapticsStreamConsume(devContext, edge);
+	}
+
+	if (devContext->Prearm.LeaseEnd != 0 && edge >= devContext->Prearm.LeaseEnd) {
+		SamsungHapticsPrearmRelax(devContext);
+	}
+
+	SamsungHapticsEffectArmTimer(devContext, now);
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
+
+NTSTATUS
+SamsungHapticsEffectInitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PAGED_CODE();
+
+	RtlZeroMemory(&devContext->Effect, sizeof(devContext->Effect));
+
+	return SamsungHapticsTimerInitialize(&devContext->Effect.Timer, SamsungHapticsEffectTimerCallback, devContext);
+}
+
+VOID
+SamsungHapticsEffectUninitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PAGED_CODE();
+
+	SamsungHapticsTimerUninitialize(&devContext->Effect.Timer);
+}
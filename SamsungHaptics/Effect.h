@@ -0,0 +1,97 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Effect.h
+
+Abstract:
+
+	Per-device effect state definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "timer.h"
+#include "saver.h"
+
+EXTERN_C_START
+
+typedef struct _SAMSUNG_HAPTICS_EFFECT_STATE
+{
+	SAMSUNG_HAPTICS_TIMER Timer; // drives the deadlines below
+
+	BOOLEAN   Active;           // motor is being driven for an effect
+	ULONG     Intensity;        // output intensity after the profile curve and saver scale
+	ULONG     Unscaled;         // output intensity before the saver scale
+	ULONGLONG StartTime;        // interrupt time the effect started
+	ULONGLONG EndTime;          // interrupt time the last effect ended
+
+	//
+	// Pending deadlines in interrupt time, 0 when not armed
+	//
+	ULONGLONG KickEnd;          // full-drive kick hands over to the modulator
+	ULONGLONG OffDeadline;      // deferred stop honoring the minimum pulse
+	ULONGLONG OnTimeLimit;      // maximum ON time cutoff
+
+	//
+	// ETW activity of the SetState request the effect is driven for, so
+	// the edges and the end raised on the timer threads join its span.
+	// Request is only set while that request holds OutputLock; ActivityId
+	// is zero for effects no request started.
+	//
+	LPCGUID   Request;
+	GUID      ActivityId;
+
+	//
+	// Battery saver accounting: whether the cutoff above is the saver's
+	// pulse limit, when it cut the effect, and since when the current
+	// intensity has been applied
+	//
+	BOOLEAN   SaverLimited;
+	ULONGLONG TruncatedAt;
+	ULONGLONG SegmentStart;
+	SAMSUNG_HAPTICS_SAVER_COUNTERS Saver;
+} SAMSUNG_HAPTICS_EFFECT_STATE, * PSAMSUNG_HAPTICS_EFFECT_STATE;
+
+struct _DEVICE_CONTEXT;
+
+NTSTATUS
+SamsungHapticsEffectInitialize(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsEffectUninitialize(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+NTSTATUS
+SamsungHapticsEffectOn(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONG Intensity
+);
+
+NTSTATUS
+SamsungHapticsEffectOff(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsEffectQuiesce(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsEffectReschedule(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+EXTERN_C_END
@@ -0,0 +1,217 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Etw.c - TraceLogging provider and activity helpers
+
+Abstract:
+
+	All payloads are fixed-size scalars so that enabling the provider adds
+	as little as possible to the latency it is measuring. When no session
+	listens, every helper returns after a single enablement check.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "etw.h"
+
+// {7284e8b8-8c41-4a40-8571-548f2a4828ae}
+TRACELOGGING_DEFINE_PROVIDER(
+	SamsungHapticsEtwProvider,
+	"SamsungHaptics",
+	(0x7284e8b8, 0x8c41, 0x4a40, 0x85, 0x71, 0x54, 0x8f, 0x2a, 0x48, 0x28, 0xae));
+
+static
+LPCGUID
+SamsungHapticsEtwActivity(
+	_In_opt_ LPCGUID ActivityId
+)
+/*++
+Routine Description:
+
+	Map an activity ID kept in device state to the one to write: NULL,
+	which means the thread's current activity, when none was recorded.
+
+--*/
+{
+	static const GUID none = { 0 };
+
+	if (ActivityId == NULL || RtlEqualMemory(ActivityId, &none, sizeof(none)))
+	{
+		return NULL;
+	}
+
+	return ActivityId;
+}
+
+NTSTATUS
+SamsungHapticsEtwRegister(
+	VOID
+)
+{
+	return TraceLoggingRegister(SamsungHapticsEtwProvider);
+}
+
+VOID
+SamsungHapticsEtwUnregister(
+	VOID
+)
+{
+	TraceLoggingUnregister(SamsungHapticsEtwProvider);
+}
+
+VOID
+SamsungHapticsEtwSetStateStart(
+	_Out_ PSAMSUNG_HAPTICS_ETW_ACTIVITY Activity,
+	_In_ ULONG HwNId,
+	_In_ ULONG OffOnBlink,
+	_In_ ULONG Intensity
+)
+/*++
+Routine Description:
+
+	Open the activity for one SetState request and make it the thread's
+	current activity, so that effect and pin events raised further down the
+	call chain are correlated with it.
+
+--*/
+{
+	Activity->Active = FALSE;
+
+	if (!TraceLoggingProviderEnabled(SamsungHapticsEtwProvider, WINEVENT_LEVEL_INFO, SAMSUNG_HAPTICS_ETW_KEYWORD_REQUEST))
+	{
+		return;
+	}
+
+	if (!NT_SUCCESS(EtwActivityIdControl(EVENT_ACTIVITY_CTRL_CREATE_ID, &Activity->ActivityId)))
+	{
+		return;
+	}
+
+	Activity->PreviousActivityId = Activity->ActivityId;
+	if (!NT_SUCCESS(EtwActivityIdControl(EVENT_ACTIVITY_CTRL_GET_SET_ID, &Activity->PreviousActivityId)))
+	{
+		return;
+	}
+
+	Activity->Active = TRUE;
+
+	TraceLoggingWriteActivity(
+		SamsungHapticsEtwProvider,
+		"SetState",
+		&Activity->ActivityId,
+		&Activity->PreviousActivityId,
+		TraceLoggingOpcode(WINEVENT_OPCODE_START),
+		TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+		TraceLoggingKeyword(SAMSUNG_HAPTICS_ETW_KEYWORD_REQUEST),
+		TraceLoggingUInt32(HwNId, "HwNId"),
+		TraceLoggingUInt32(OffOnBlink, "OffOnBlink"),
+		TraceLoggingUInt32(Intensity, "Intensity"));
+}
+
+VOID
+SamsungHapticsEtwSetStateStop(
+	_Inout_ PSAMSUNG_HAPTICS_ETW_ACTIVITY Activity,
+	_In_ NTSTATUS Status
+)
+/*++
+Routine Description:
+
+	Close the activity opened by SamsungHapticsEtwSetStateStart and restore
+	the activity ID the thread had before the request.
+
+--*/
+{
+	if (!Activity->Active)
+	{
+		return;
+	}
+
+	TraceLoggingWriteActivity(
+		SamsungHapticsEtwProvider,
+		"SetState",
+		&Activity->ActivityId,
+		NULL,
+		TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+		TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+		TraceLoggingKeyword(SAMSUNG_HAPTICS_ETW_KEYWORD_REQUEST),
+		TraceLoggingNTStatus(Status, "Status"));
+
+	EtwActivityIdControl(EVENT_ACTIVITY_CTRL_SET_ID, &Activity->PreviousActivityId);
+	Activity->Active = FALSE;
+}
+
+VOID
+SamsungHapticsEtwEffectStart(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ ULONG HwNId,
+	_In_ ULONG Intensity
+)
+{
+	TraceLoggingWriteActivity(
+		SamsungHapticsEtwProvider,
+		"EffectStart",
+		SamsungHapticsEtwActivity(ActivityId),
+		NULL,
+		TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+		TraceLoggingKeyword(SAMSUNG_HAPTICS_ETW_KEYWORD_EFFECT),
+		TraceLoggingUInt32(HwNId, "HwNId"),
+		TraceLoggingUInt32(Intensity, "Intensity"));
+}
+
+VOID
+SamsungHapticsEtwEffectEnd(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ ULONG HwNId
+)
+{
+	TraceLoggingWriteActivity(
+		SamsungHapticsEtwProvider,
+		"EffectEnd",
+		SamsungHapticsEtwActivity(ActivityId),
+		NULL,
+		TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+		TraceLoggingKeyword(SAMSUNG_HAPTICS_ETW_KEYWORD_EFFECT),
+		TraceLoggingUInt32(HwNId, "HwNId"));
+}
+
+VOID
+SamsungHapticsEtwPinWriteSubmit(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ UCHAR Value
+)
+{
+	TraceLoggingWriteActivity(
+		SamsungHapticsEtwProvider,
+		"PinWriteSubmit",
+		SamsungHapticsEtwActivity(ActivityId),
+		NULL,
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+		TraceLoggingKeyword(SAMSUNG_HAPTICS_ETW_KEYWORD_PIN),
+		TraceLoggingUInt8(Value, "Value"));
+}
+
+VOID
+SamsungHapticsEtwPinWriteComplete(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ UCHAR Value,
+	_In_ NTSTATUS Status
+)
+{
+	TraceLoggingWriteActivity(
+		SamsungHapticsEtwProvider,
+		"PinWriteComplete",
+		SamsungHapticsEtwActivity(ActivityId),
+		NULL,
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+		TraceLoggingKeyword(SAMSUNG_HAPTICS_ETW_KEYWORD_PIN),
+		TraceLoggingUInt8(Value, "Value"),
+		TraceLoggingNTStatus(Status, "Status"));
+}
@@ -0,0 +1,102 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Etw.h
+
+Abstract:
+
+	TraceLogging events used to correlate a HwnClx request with the GPIO
+	writes it causes. Unlike the WPP messages in Trace.h, these carry
+	activity IDs so WPA can show each request as a single timed span.
+
+Environment:
+
+	Kernel mode
+
+--*/
+
+#pragma once
+
+#include <TraceLoggingProvider.h>
+#include <winmeta.h>
+
+EXTERN_C_START
+
+TRACELOGGING_DECLARE_PROVIDER(SamsungHapticsEtwProvider);
+
+//
+// Keywords
+//
+#define SAMSUNG_HAPTICS_ETW_KEYWORD_REQUEST 0x1
+#define SAMSUNG_HAPTICS_ETW_KEYWORD_EFFECT  0x2
+#define SAMSUNG_HAPTICS_ETW_KEYWORD_PIN     0x4
+
+//
+// Per-request activity. Lives on the stack of the HwnClx callback; while it
+// is active the thread's activity ID is set so nested events join the span.
+// Events raised later on the timer threads cannot rely on that, so the
+// effect and pin helpers take the activity ID explicitly; a NULL or zero ID
+// falls back to the thread's own.
+//
+typedef struct _SAMSUNG_HAPTICS_ETW_ACTIVITY
+{
+	GUID    ActivityId;
+	GUID    PreviousActivityId;
+	BOOLEAN Active;
+} SAMSUNG_HAPTICS_ETW_ACTIVITY, * PSAMSUNG_HAPTICS_ETW_ACTIVITY;
+
+NTSTATUS
+SamsungHapticsEtwRegister(
+	VOID
+);
+
+VOID
+SamsungHapticsEtwUnregister(
+	VOID
+);
+
+VOID
+SamsungHapticsEtwSetStateStart(
+	_Out_ PSAMSUNG_HAPTICS_ETW_ACTIVITY Activity,
+	_In_ ULONG HwNId,
+	_In_ ULONG OffOnBlink,
+	_In_ ULONG Intensity
+);
+
+VOID
+SamsungHapticsEtwSetStateStop(
+	_Inout_ PSAMSUNG_HAPTICS_ETW_ACTIVITY Activity,
+	_In_ NTSTATUS Status
+);
+
+VOID
+SamsungHapticsEtwEffectStart(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ ULONG HwNId,
+	_In_ ULONG Intensity
+);
+
+VOID
+SamsungHapticsEtwEffectEnd(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ ULONG HwNId
+);
+
+VOID
+SamsungHapticsEtwPinWriteSubmit(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ UCHAR Value
+);
+
+VOID
+SamsungHapticsEtwPinWriteComplete(
+	_In_opt_ LPCGUID ActivityId,
+	_In_ UCHAR Value,
+	_In_ NTSTATUS Status
+);
+
+EXTERN_C_END
@@ -29,8 +29,6 @@ Environment:
 #pragma alloc_text (PAGE, SamsungHapticsGetState)
 #endif
 
-PDEVICE_CONTEXT globalContext = NULL;
-
 NTSTATUS
 SamsungHapticsInitializeDevice(
 	__in WDFDEVICE Device,
@@ -50,8 +48,9 @@ SamsungHapticsInitializeDevice(
 
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
-	globalContext = devContext;
 	devContext->Device = Device;
+	devContext->RegistryIndex = SAMSUNG_HAPTICS_INVALID_REGISTRY_INDEX;
+	devContext->Stopped = TRUE;
 
 	for (ULONG i = 0; i < count; i++)
 	{
@@ -125,6 +124,67 @@ SamsungHapticsInitializeDevice(
 		}
 	}
 
+	{
+		WDF_OBJECT_ATTRIBUTES lockAttributes;
+		WDF_OBJECT_ATTRIBUTES_INIT(&lockAttributes);
+		lockAttributes.ParentObject = Device;
+		status = WdfWaitLockCreate(&lockAttributes, &devContext->OutputLock);
+		if (!NT_SUCCESS(status)) {
+			Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "WdfWaitLockCreate failed - %!STATUS!", status);
+			goto exit;
+		}
+	}
+
+	status = SamsungHapticsCpuCountersInitialize(devContext);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "SamsungHapticsCpuCountersInitialize failed - %!STATUS!", status);
+		goto exit;
+	}
+
+	status = SamsungHapticsDirectOutputInitialize(devContext);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "SamsungHapticsDirectOutputInitialize failed - %!STATUS!", status);
+		goto exit;
+	}
+
+	SamsungHapticsMotorModelInitialize(&devContext->Motor);
+
+	//
+	// Until the device starts and loads its profile, run with defaults.
+	//
+	devContext->Profile = &SamsungHapticsDefaultProfile;
+
+	SamsungHapticsMixerInitialize(&devContext->Mixer);
+	SamsungHapticsScheduleCacheInitialize(&devContext->ScheduleCache);
+	SamsungHapticsCalibrationInitialize(&devContext->Calibration);
+	SamsungHapticsRecorderInitialize(&devContext->Recorder);
+	SamsungHapticsStreamInitialize(&devContext->Stream);
+
+	status = SamsungHapticsEffectInitialize(devContext);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "SamsungHapticsEffectInitialize failed - %!STATUS!", status);
+		goto exit;
+	}
+
+	status = SamsungHapticsModulatorInitialize(devContext);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "SamsungHapticsModulatorInitialize failed - %!STATUS!", status);
+		goto exit;
+	}
+
+	//
+	// Make this instance visible to driver-wide code. Every other piece of
+	// state lives in devContext, so several SECHWN nodes can coexist.
+	//
+	status = SamsungHapticsRegisterDeviceContext(devContext);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "SamsungHapticsRegisterDeviceContext failed - %!STATUS!", status);
+		goto exit;
+	}
+
+	SamsungHapticsControlDeviceReference();
+	devContext->ControlReferenced = TRUE;
+
 exit:
 	return status;
 }
@@ -147,6 +207,29 @@ SamsungHapticsUnInitializeDevice(
 
 	PDEVICE_CONTEXT devContext = (PDEVICE_CONTEXT)Context;
 
+	SamsungHapticsUnregisterDeviceContext(devContext);
+	SamsungHapticsStreamRundown(devContext);
+
+	if (devContext->ControlReferenced) {
+		devContext->ControlReferenced = FALSE;
+		SamsungHapticsControlDeviceRelease();
+	}
+
+	SamsungHapticsEffectUninitialize(devContext);
+
+	if (devContext->OutputLock != NULL) {
+		WdfWaitLockAcquire(devContext->OutputLock, NULL);
+		SamsungHapticsPrearmRelax(devContext);
+		WdfWaitLockRelease(devContext->OutputLock);
+	}
+
+	SamsungHapticsModulatorUninitialize(devContext);
+	SamsungHapticsDirectOutputUninitialize(devContext);
+	SamsungHapticsProfileRelease(devContext);
+	SamsungHapticsLibraryRelease(devContext);
+	SamsungHapticsRecorderUninitialize(&devContext->Recorder);
+	SamsungHapticsCpuCountersUninitialize(devContext);
+
 	currentState = devContext->CurrentStates;
 
 	while (currentState != NULL)
@@ -191,13 +274,93 @@ SamsungHapticsStartDevice(
 	__in PVOID Context
 )
 {
-	UNREFERENCED_PARAMETER(Context);
 	NTSTATUS status = STATUS_SUCCESS;
+	PDEVICE_CONTEXT devContext = (PDEVICE_CONTEXT)Context;
+	PSAMSUNG_HAPTICS_CURRENT_STATE currentState;
+	LARGE_INTEGER start;
+	ULONGLONG elapsedUs;
 
 	PAGED_CODE();
 
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+	start = KeQueryPerformanceCounter(NULL);
+
+	//
+	// Parse the tuning profile and the effect library on the first start
+	// only; the output path only reads the resulting blocks. Later D0
+	// entries keep them, along with the library voices, schedules and
+	// modulator settings built on them, and
+	// IOCTL_SAMSUNG_HAPTICS_PROFILE_RELOAD reads them again on demand.
+	//
+	if (!devContext->TuningLoaded) {
+		devContext->TuningLoaded = TRUE;
+
+		status = SamsungHapticsProfileLoad(devContext);
+		if (!NT_SUCCESS(status)) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_DRIVER, "SamsungHapticsProfileLoad failed - %!STATUS!", status);
+			status = STATUS_SUCCESS;
+		}
+
+		status = SamsungHapticsLibraryLoad(devContext);
+		if (!NT_SUCCESS(status)) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_DRIVER, "SamsungHapticsLibraryLoad failed - %!STATUS!", status);
+			status = STATUS_SUCCESS;
+		}
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	//
+	// The cached HwN state is authoritative: rebuild the HwN voice from it
+	// while still stopped, then apply the whole mix with one pin write.
+	//
+	currentState = devContext->CurrentStates;
+	while (currentState != NULL && currentState->CurrentState.HwNId != 0) {
+		currentState = currentState->NextState;
+	}
+
+	if (currentState != NULL && currentState->CurrentState.OffOnBlink == HWN_ON) {
+		SamsungHapticsMixerSetVoice(
+			devContext,
+			SamsungHapticsVoiceHwn,
+			currentState->CurrentState.HwNSettings[HWN_INTENSITY],
+			0,
+			SamsungHapticsPriorityNormal,
+			SamsungHapticsPreemptResume);
+	}
+	else if (!SamsungHapticsMixerVoicePreempted(devContext, SamsungHapticsVoiceHwn)) {
+		//
+		// A preempted HwN voice is cached as off while it waits to resume;
+		// keep it.
+		//
+		SamsungHapticsMixerClearVoice(devContext, SamsungHapticsVoiceHwn);
+	}
+
+	devContext->Stopped = FALSE;
+	status = SamsungHapticsMixerRestore(devContext);
+
+	elapsedUs = SamsungHapticsElapsedUs(start);
+	devContext->Power.LastStartUs = (ULONG)min(elapsedUs, MAXULONG);
+	SamsungHapticsLatencyAdd(&devContext->Power.Start, elapsedUs);
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Output restored in %llu us - %!STATUS!", elapsedUs, status);
+
+	//
+	// Measure the pin path on the first start, once it is powered; a
+	// failure leaves the timing uncompensated. Later D0 entries reuse the
+	// result so resume does not pay for the burst of writes, and
+	// IOCTL_SAMSUNG_HAPTICS_CALIBRATE measures again on demand.
+	//
+	if (NT_SUCCESS(status) && ReadULongNoFence(&devContext->Calibration.Result.Runs) == 0) {
+		NTSTATUS calibrationStatus = SamsungHapticsCalibrate(devContext, NULL);
+		if (!NT_SUCCESS(calibrationStatus)) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_DRIVER, "SamsungHapticsCalibrate failed - %!STATUS!", calibrationStatus);
+		}
+	}
+
 	return status;
 }
 
@@ -206,13 +369,36 @@ SamsungHapticsStopDevice(
 	__in PVOID Context
 )
 {
-	UNREFERENCED_PARAMETER(Context);
 	NTSTATUS status = STATUS_SUCCESS;
+	PDEVICE_CONTEXT devContext = (PDEVICE_CONTEXT)Context;
+	LARGE_INTEGER start;
+	ULONGLONG elapsedUs;
 
 	PAGED_CODE();
 
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+	start = KeQueryPerformanceCounter(NULL);
+
+	//
+	// Drive the motor low and disarm every output timer. Ticks or timer
+	// callbacks already waiting for the lock find the device stopped and
+	// leave the pin alone.
+	//
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	devContext->Stopped = TRUE;
+	SamsungHapticsMixerQuiesce(devContext);
+	SamsungHapticsPrearmRelax(devContext);
+
+	elapsedUs = SamsungHapticsElapsedUs(start);
+	devContext->Power.LastStopUs = (ULONG)min(elapsedUs, MAXULONG);
+	SamsungHapticsLatencyAdd(&devContext->Power.Stop, elapsedUs);
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "Output quiesced in %llu us", elapsedUs);
+
 	return status;
 }
 
@@ -230,6 +416,9 @@ SamsungHapticsSetState(
 	NTSTATUS status = STATUS_SUCCESS;
 	PDEVICE_CONTEXT devContext = (PDEVICE_CONTEXT)Context;
 	PHWN_HEADER hwnHeader = (PHWN_HEADER)Buffer;
+	SAMSUNG_HAPTICS_ETW_ACTIVITY activity;
+	ULONGLONG timestamp = KeQueryInterruptTime();
+	LARGE_INTEGER start = KeQueryPerformanceCounter(NULL);
 
 	PAGED_CODE();
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_INIT, "%!FUNC! Entry");
@@ -237,11 +426,30 @@ SamsungHapticsSetState(
 	// Expect exactly one device's settings:
 	if (BufferLength != (HWN_HEADER_SIZE + HWN_SETTINGS_SIZE)) {
 		Trace(TRACE_LEVEL_INFORMATION, TRACE_INIT, "Invalid buffer size");
+		SamsungHapticsRecorderCapture(
+			&devContext->Recorder,
+			SamsungHapticsRecordSetState,
+			STATUS_INVALID_BUFFER_SIZE,
+			timestamp,
+			start,
+			Buffer,
+			BufferLength);
 		return STATUS_INVALID_BUFFER_SIZE;
 	}
 
+	SamsungHapticsEtwSetStateStart(
+		&activity,
+		hwnHeader->HwNSettingsInfo[0].HwNId,
+		hwnHeader->HwNSettingsInfo[0].OffOnBlink,
+		hwnHeader->HwNSettingsInfo[0].HwNSettings[HWN_INTENSITY]);
+
+	SamsungHapticsCallbackEnter(devContext, TRUE);
+
 	// Call the device-specific routine to update the state.
-	status = SamsungHapticsSetDevice(devContext, &hwnHeader->HwNSettingsInfo[0]);
+	status = SamsungHapticsSetDevice(
+		devContext,
+		&hwnHeader->HwNSettingsInfo[0],
+		activity.Active ? &activity.ActivityId : NULL);
 	if (!NT_SUCCESS(status)) {
 		goto exit;
 	}
@@ -252,9 +460,25 @@ SamsungHapticsSetState(
 		goto exit;
 	}
 
+	// The mixer may already have silenced the new voice (a higher priority
+	// voice is playing) or retired it; keep the cache on the output state.
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+	SamsungHapticsHwnStateSync(devContext);
+	WdfWaitLockRelease(devContext->OutputLock);
+
 	*BytesWritten = BufferLength;
 
 exit:
+	SamsungHapticsCallbackLeave(devContext);
+	SamsungHapticsEtwSetStateStop(&activity, status);
+	SamsungHapticsRecorderCapture(
+		&devContext->Recorder,
+		SamsungHapticsRecordSetState,
+		status,
+		timestamp,
+		start,
+		Buffer,
+		BufferLength);
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_INIT, "%!FUNC! Exit");
 	return status;
 }
@@ -274,6 +498,8 @@ SamsungHapticsGetState(
 	NTSTATUS status = STATUS_SUCCESS;
 	PDEVICE_CONTEXT devContext = (PDEVICE_CONTEXT)Context;
 	PHWN_HEADER hwnHeader = (PHWN_HEADER)OutputBuffer;
+	ULONGLONG timestamp = KeQueryInterruptTime();
+	LARGE_INTEGER start = KeQueryPerformanceCounter(NULL);
 
 	PAGED_CODE();
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_INIT, "%!FUNC! Entry");
@@ -281,6 +507,14 @@ SamsungHapticsGetState(
 	// Expect exactly one device's information.
 	if (OutputBufferLength != (HWN_HEADER_SIZE + HWN_SETTINGS_SIZE)) {
 		Trace(TRACE_LEVEL_INFORMATION, TRACE_INIT, "Invalid output buffer size");
+		SamsungHapticsRecorderCapture(
+			&devContext->Recorder,
+			SamsungHapticsRecordGetState,
+			STATUS_INVALID_BUFFER_SIZE,
+			timestamp,
+			start,
+			NULL,
+			OutputBufferLength);
 		return STATUS_INVALID_BUFFER_SIZE;
 	}
 
@@ -291,7 +525,12 @@ SamsungHapticsGetState(
 
 	// Populate the settings for device 0.
 	hwnHeader->HwNSettingsInfo[0].HwNId = 0;
+	SamsungHapticsCallbackEnter(devContext, FALSE);
 	status = SamsungHapticsGetCurrentDeviceState(devContext, &hwnHeader->HwNSettingsInfo[0], HWN_SETTINGS_SIZE);
+	if (NT_SUCCESS(status)) {
+		SamsungHapticsStateCheckConsistency(devContext, &hwnHeader->HwNSettingsInfo[0]);
+	}
+	SamsungHapticsCallbackLeave(devContext);
 	if (!NT_SUCCESS(status)) {
 		goto exit;
 	}
@@ -299,6 +538,14 @@ SamsungHapticsGetState(
 	*BytesRead = OutputBufferLength;
 
 exit:
+	SamsungHapticsRecorderCapture(
+		&devContext->Recorder,
+		SamsungHapticsRecordGetState,
+		status,
+		timestamp,
+		start,
+		OutputBuffer,
+		OutputBufferLength);
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_INIT, "%!FUNC! Exit");
 	return status;
 }
\ No newline at end of file
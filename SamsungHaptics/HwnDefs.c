@@ -18,40 +18,78 @@ Environment:
 #include "driver.h"
 #include "HwnDefs.tmh"
 
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsConcurrencyQuery)
+#endif
+
 NTSTATUS
 SamsungHapticsToggleVibrationMotor(
 	PDEVICE_CONTEXT devContext,
 	HWN_STATE hwnState,
-	ULONG* hwnIntensity
+	ULONG* hwnIntensity,
+	LPCGUID ActivityId
 )
 {
-	UNREFERENCED_PARAMETER(hwnIntensity);
+	NTSTATUS Status;
+	LARGE_INTEGER start;
+	BOOLEAN cold;
+
 	Trace(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+	start = KeQueryPerformanceCounter(NULL);
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	// Whatever the mixer does to the effect below is done for this request.
+	devContext->Effect.Request = ActivityId;
+
 	switch (hwnState) {
 	case HWN_OFF:
 	{
 		devContext->PreviousState = HWN_OFF;
-		return GpioWritePin(devContext, 0);  // drive GPIO low
+		Status = SamsungHapticsMixerClearVoice(devContext, SamsungHapticsVoiceHwn);
 		break;
 	}
 	case HWN_ON:
 	{
 		devContext->PreviousState = HWN_ON;
-		return GpioWritePin(devContext, 1);  // drive GPIO high
+
+		cold = !devContext->Stopped && !devContext->Effect.Active &&
+			(KeQueryInterruptTime() - devContext->Effect.EndTime) >= (ULONGLONG)SAMSUNG_HAPTICS_PREARM_IDLE_THRESHOLD_MS * 10000;
+
+		Status = SamsungHapticsMixerSetVoice(
+			devContext,
+			SamsungHapticsVoiceHwn,
+			*hwnIntensity,
+			0,
+			SamsungHapticsPriorityNormal,
+			SamsungHapticsPreemptResume);
+
+		if (cold && NT_SUCCESS(Status))
+		{
+			SamsungHapticsPrearmRecordLatency(devContext, SamsungHapticsElapsedUs(start));
+		}
 		break;
 	}
 	default:
 	{
-		return STATUS_NOT_IMPLEMENTED;
+		Status = STATUS_NOT_IMPLEMENTED;
+		break;
 	}
 	}
+
+	devContext->Effect.Request = NULL;
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	return Status;
 }
 
 NTSTATUS
 SamsungHapticsSetDevice(
     PDEVICE_CONTEXT devContext,
-    PHWN_SETTINGS hwnSettings
+    PHWN_SETTINGS hwnSettings,
+    LPCGUID ActivityId
 )
 {
     if (devContext == NULL || hwnSettings == NULL) {
@@ -63,12 +101,14 @@ SamsungHapticsSetDevice(
         return STATUS_INVALID_PARAMETER;
     }
 
-    // Just toggle the vibrator based on OffOnBlink.
-	// Intensity is ignored
+    // Toggle the HwN voice based on OffOnBlink. The mixed intensity is
+	// mapped through the tuning profile and only honored when a modulator
+	// is configured.
     return SamsungHapticsToggleVibrationMotor(
                devContext,
                hwnSettings->OffOnBlink,
-               &hwnSettings->HwNSettings[HWN_INTENSITY]
+               &hwnSettings->HwNSettings[HWN_INTENSITY],
+               ActivityId
            );
 }
 
@@ -282,4 +322,128 @@ SamsungHapticsSetCurrentDeviceState(
 	}
 
 	return Status;
-}
\ No newline at end of file
+}
+
+VOID
+SamsungHapticsHwnStateSync(
+	PDEVICE_CONTEXT devContext
+)
+/*++
+
+Routine Description:
+
+	Copies the state driven to the output into the cached state of HwN 0.
+	The mixer calls this when it silences, resumes or retires the HwN
+	voice on its own, so GetState reports what the motor is doing rather
+	than the last request. Must be called with OutputLock held.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_CURRENT_STATE currentState = devContext->CurrentStates;
+
+	while (currentState != NULL && currentState->CurrentState.HwNId != 0)
+	{
+		currentState = currentState->NextState;
+	}
+
+	if (currentState != NULL)
+	{
+		currentState->CurrentState.OffOnBlink = devContext->PreviousState;
+	}
+}
+
+VOID
+SamsungHapticsCallbackEnter(
+	PDEVICE_CONTEXT devContext,
+	BOOLEAN SetState
+)
+/*++
+
+Routine Description:
+
+	Counts an HwnClx callback entering the driver. HwnClx may call
+	SetState and GetState from several threads at once; the counters
+	measure how often that happens, without serializing the callbacks.
+
+Arguments:
+
+	devContext - The device context
+	SetState - TRUE for SetState, FALSE for GetState
+
+Return Value:
+
+	None
+
+--*/
+{
+	PSAMSUNG_HAPTICS_CPU_COUNTERS counters;
+	LONG inFlight;
+	LONG maxInFlight;
+
+	counters = SamsungHapticsCpuCountersLocal(devContext);
+	InterlockedIncrement64(SetState ? &counters->SetStateCalls : &counters->GetStateCalls);
+
+	inFlight = InterlockedIncrement(&devContext->CallbacksInFlight);
+	if (inFlight > 1) {
+		InterlockedIncrement((volatile LONG*)&devContext->Concurrency.Overlapped);
+	}
+
+	maxInFlight = ReadNoFence((volatile LONG*)&devContext->Concurrency.MaxInFlight);
+	while (inFlight > maxInFlight) {
+		LONG previous = InterlockedCompareExchange(
+			(volatile LONG*)&devContext->Concurrency.MaxInFlight,
+			inFlight,
+			maxInFlight);
+		if (previous == maxInFlight) {
+			break;
+		}
+		maxInFlight = previous;
+	}
+}
+
+VOID
+SamsungHapticsCallbackLeave(
+	PDEVICE_CONTEXT devContext
+)
+{
+	InterlockedDecrement(&devContext->CallbacksInFlight);
+}
+
+VOID
+SamsungHapticsStateCheckConsistency(
+	PDEVICE_CONTEXT devContext,
+	PHWN_SETTINGS hwnSettings
+)
+/*++
+
+Routine Description:
+
+	Counts GetState results whose on/off state disagrees with the last
+	state driven to the output. Callbacks are not serialized, so this
+	includes GetState calls that raced a SetState.
+
+--*/
+{
+	if (hwnSettings->HwNId == 0 && hwnSettings->OffOnBlink != devContext->PreviousState) {
+		InterlockedIncrement((volatile LONG*)&devContext->Concurrency.Inconsistent);
+		Trace(TRACE_LEVEL_WARNING, TRACE_DRIVER, "Cached state %d does not match output state %d",
+			hwnSettings->OffOnBlink, devContext->PreviousState);
+	}
+}
+
+VOID
+SamsungHapticsConcurrencyQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_CONCURRENCY_STATISTICS Statistics
+)
+{
+	SAMSUNG_HAPTICS_CPU_COUNTERS total;
+
+	PAGED_CODE();
+
+	*Statistics = devContext->Concurrency;
+
+	SamsungHapticsCpuCountersSum(devContext, &total);
+	Statistics->SetStateCalls = (ULONG)total.SetStateCalls;
+	Statistics->GetStateCalls = (ULONG)total.GetStateCalls;
+}
@@ -22,7 +22,8 @@ Environment:
 NTSTATUS
 SamsungHapticsSetDevice(
 	PDEVICE_CONTEXT devContext,
-	PHWN_SETTINGS hwnSettings
+	PHWN_SETTINGS hwnSettings,
+	LPCGUID ActivityId
 );
 
 NTSTATUS
@@ -42,4 +43,32 @@ SamsungHapticsSetCurrentDeviceState(
 	PDEVICE_CONTEXT devContext,
 	PHWN_SETTINGS hwnSettings,
 	ULONG hwnSettingsLength
-);
\ No newline at end of file
+);
+
+VOID
+SamsungHapticsHwnStateSync(
+	PDEVICE_CONTEXT devContext
+);
+
+VOID
+SamsungHapticsCallbackEnter(
+	PDEVICE_CONTEXT devContext,
+	BOOLEAN SetState
+);
+
+VOID
+SamsungHapticsCallbackLeave(
+	PDEVICE_CONTEXT devContext
+);
+
+VOID
+SamsungHapticsStateCheckConsistency(
+	PDEVICE_CONTEXT devContext,
+	PHWN_SETTINGS hwnSettings
+);
+
+VOID
+SamsungHapticsConcurrencyQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_CONCURRENCY_STATISTICS Statistics
+);
@@ -0,0 +1,419 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Library.c - Preloaded effect library
+
+Abstract:
+
+	Notification patterns used to be sent as a full sequence every time
+	they played. The patterns now live in the device hardware key, as an
+	"EffectLibrary" binary value an INF can ship with AddReg, and are
+	loaded when the device starts or the profile is reloaded.
+
+	Each load validates the whole blob once and builds a compact immutable
+	nonpaged table: an index by effect id and the steps of every effect back
+	to back. Playing an effect is then an index lookup; a timed voice of the
+	mixer walks the steps in place and nothing is parsed or copied per
+	request. A blob that fails validation is rejected as a whole and the
+	previous table stays in use.
+
+	The table is swapped while OutputLock is held. Sequences still playing
+	from the previous table are stopped in the same critical section, so it
+	can be freed as soon as the lock is released.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "library.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsLibraryLoad)
+#pragma alloc_text (PAGE, SamsungHapticsLibraryRelease)
+#pragma alloc_text (PAGE, SamsungHapticsLibraryPlay)
+#pragma alloc_text (PAGE, SamsungHapticsLibraryQuery)
+#endif
+
+#define LIBRARY_MAX_BLOB_SIZE \
+	(sizeof(SAMSUNG_HAPTICS_LIBRARY_HEADER) + \
+	 SAMSUNG_HAPTICS_LIBRARY_MAX_ID * sizeof(SAMSUNG_HAPTICS_LIBRARY_ENTRY) + \
+	 SAMSUNG_HAPTICS_LIBRARY_MAX_TOTAL * sizeof(SAMSUNG_HAPTICS_LIBRARY_STEP))
+
+static
+NTSTATUS
+SamsungHapticsLibraryValidate(
+	_In_reads_bytes_(Length) const UCHAR* Blob,
+	_In_ ULONG Length,
+	_Out_ PULONG Effects,
+	_Out_ PULONG Steps
+)
+/*++
+Routine Description:
+
+	Walk the blob once and check every field, so the table built from it
+	can be trusted without checks on the playback path.
+
+--*/
+{
+	const SAMSUNG_HAPTICS_LIBRARY_HEADER* header = (const SAMSUNG_HAPTICS_LIBRARY_HEADER*)Blob;
+	ULONGLONG seen = 0;
+	ULONG offset;
+	ULONG steps = 0;
+	ULONG i;
+	ULONG j;
+
+	if (Length < sizeof(*header) ||
+		header->Signature != SAMSUNG_HAPTICS_LIBRARY_SIGNATURE ||
+		header->Version != SAMSUNG_HAPTICS_LIBRARY_VERSION ||
+		header->EffectCount == 0 ||
+		header->EffectCount > SAMSUNG_HAPTICS_LIBRARY_MAX_ID) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary header malformed");
+		return STATUS_DATA_ERROR;
+	}
+
+	offset = sizeof(*header);
+
+	for (i = 0; i < header->EffectCount; i++) {
+		const SAMSUNG_HAPTICS_LIBRARY_ENTRY* entry;
+		const SAMSUNG_HAPTICS_LIBRARY_STEP* step;
+		ULONG durationMs = 0;
+
+		if (Length - offset < sizeof(*entry)) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary truncated at effect %u", i);
+			return STATUS_DATA_ERROR;
+		}
+
+		entry = (const SAMSUNG_HAPTICS_LIBRARY_ENTRY*)(Blob + offset);
+		offset += sizeof(*entry);
+
+		if (entry->Id == 0 || entry->Id > SAMSUNG_HAPTICS_LIBRARY_MAX_ID || (seen & (1ULL << entry->Id)) != 0) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary effect %u has invalid or duplicate id %u", i, entry->Id);
+			return STATUS_DATA_ERROR;
+		}
+
+		seen |= 1ULL << entry->Id;
+
+		if (entry->StepCount == 0 || entry->StepCount > SAMSUNG_HAPTICS_LIBRARY_MAX_STEPS ||
+			steps + entry->StepCount > SAMSUNG_HAPTICS_LIBRARY_MAX_TOTAL ||
+			(Length - offset) / sizeof(*step) < entry->StepCount) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary effect %u has invalid step count %u", entry->Id, entry->StepCount);
+			return STATUS_DATA_ERROR;
+		}
+
+		step = (const SAMSUNG_HAPTICS_LIBRARY_STEP*)(Blob + offset);
+
+		for (j = 0; j < entry->StepCount; j++) {
+			if (step[j].Intensity > SAMSUNG_HAPTICS_MAX_INTENSITY || step[j].DurationMs == 0) {
+				Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary effect %u step %u out of range", entry->Id, j);
+				return STATUS_DATA_ERROR;
+			}
+
+			durationMs += step[j].DurationMs;
+		}
+
+		if (durationMs > SAMSUNG_HAPTICS_LIBRARY_MAX_EFFECT_MS) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary effect %u lasts %u ms, too long", entry->Id, durationMs);
+			return STATUS_DATA_ERROR;
+		}
+
+		offset += entry->StepCount * sizeof(*step);
+		steps += entry->StepCount;
+	}
+
+	if (offset != Length) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary has %u trailing bytes", Length - offset);
+		return STATUS_DATA_ERROR;
+	}
+
+	*Effects = header->EffectCount;
+	*Steps = steps;
+
+	return STATUS_SUCCESS;
+}
+
+static
+PSAMSUNG_HAPTICS_LIBRARY
+SamsungHapticsLibraryBuild(
+	_In_reads_bytes_(Length) const UCHAR* Blob,
+	_In_ ULONG Length,
+	_In_ ULONG Effects,
+	_In_ ULONG Steps
+)
+/*++
+Routine Description:
+
+	Build the table from a validated blob.
+
+--*/
+{
+	const SAMSUNG_HAPTICS_LIBRARY_HEADER* header = (const SAMSUNG_HAPTICS_LIBRARY_HEADER*)Blob;
+	PSAMSUNG_HAPTICS_LIBRARY table;
+	ULONG size;
+	ULONG offset = sizeof(*header);
+	ULONG next = 0;
+	ULONG i;
+
+	UNREFERENCED_PARAMETER(Length);
+
+	size = FIELD_OFFSET(SAMSUNG_HAPTICS_LIBRARY, Steps) + Steps * sizeof(SAMSUNG_HAPTICS_LIBRARY_STEP);
+
+	table = (PSAMSUNG_HAPTICS_LIBRARY)ExAllocatePool2(POOL_FLAG_NON_PAGED, size, HAPTICS_POOL_TAG);
+	if (table == NULL) {
+		return NULL;
+	}
+
+	table->Effects = Effects;
+	table->Footprint = size;
+	table->StepCount = Steps;
+
+	for (i = 0; i < header->EffectCount; i++) {
+		const SAMSUNG_HAPTICS_LIBRARY_ENTRY* entry = (const SAMSUNG_HAPTICS_LIBRARY_ENTRY*)(Blob + offset);
+
+		offset += sizeof(*entry);
+
+		table->Index[entry->Id].First = (USHORT)next;
+		table->Index[entry->Id].Count = entry->StepCount;
+
+		RtlCopyMemory(&table->Steps[next], Blob + offset, entry->StepCount * sizeof(SAMSUNG_HAPTICS_LIBRARY_STEP));
+
+		offset += entry->StepCount * sizeof(SAMSUNG_HAPTICS_LIBRARY_STEP);
+		next += entry->StepCount;
+	}
+
+	return table;
+}
+
+NTSTATUS
+SamsungHapticsLibraryLoad(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Read, validate and publish the effect library. A missing value unloads
+	the library; a malformed one keeps the previous table.
+
+--*/
+{
+	NTSTATUS status;
+	WDFKEY key;
+	PUCHAR blob = NULL;
+	ULONG length = 0;
+	ULONG type = 0;
+	ULONG effects = 0;
+	ULONG steps = 0;
+	PSAMSUNG_HAPTICS_LIBRARY table = NULL;
+	PCSAMSUNG_HAPTICS_LIBRARY previous;
+	DECLARE_CONST_UNICODE_STRING(valueName, L"EffectLibrary");
+
+	PAGED_CODE();
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_REGISTRY, "%!FUNC! Entry");
+
+	status = WdfDeviceOpenRegistryKey(
+		devContext->Device,
+		PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&key);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "WdfDeviceOpenRegistryKey failed - %!STATUS!", status);
+		goto exit;
+	}
+
+	blob = (PUCHAR)ExAllocatePool2(POOL_FLAG_PAGED, LIBRARY_MAX_BLOB_SIZE, HAPTICS_POOL_TAG);
+	if (blob == NULL) {
+		WdfRegistryClose(key);
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	status = WdfRegistryQueryValue(key, &valueName, LIBRARY_MAX_BLOB_SIZE, blob, &length, &type);
+	WdfRegistryClose(key);
+
+	if (status == STATUS_OBJECT_NAME_NOT_FOUND) {
+		//
+		// No library: publish the empty table below.
+		//
+	}
+	else if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary unreadable - %!STATUS!", status);
+		goto exit;
+	}
+	else if (type != REG_BINARY) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "EffectLibrary is not REG_BINARY");
+		status = STATUS_DATA_ERROR;
+		goto exit;
+	}
+	else {
+		status = SamsungHapticsLibraryValidate(blob, length, &effects, &steps);
+		if (!NT_SUCCESS(status)) {
+			goto exit;
+		}
+
+		table = SamsungHapticsLibraryBuild(blob, length, effects, steps);
+		if (table == NULL) {
+			status = STATUS_INSUFFICIENT_RESOURCES;
+			goto exit;
+		}
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+	previous = devContext->Library.Table;
+	devContext->Library.Table = table;
+	devContext->Library.LoadStatus = status;
+	if (previous != NULL) {
+		SamsungHapticsMixerStopSequences(devContext);
+	}
+	SamsungHapticsScheduleCacheFlush(&devContext->ScheduleCache);
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	if (previous != NULL) {
+		ExFreePoolWithTag((PVOID)previous, HAPTICS_POOL_TAG);
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_REGISTRY,
+		"Effect library loaded: %u effects, %u steps, %u bytes",
+		effects,
+		steps,
+		(table != NULL) ? table->Footprint : 0);
+
+	status = STATUS_SUCCESS;
+
+exit:
+	if (!NT_SUCCESS(status)) {
+		WdfWaitLockAcquire(devContext->OutputLock, NULL);
+		devContext->Library.LoadStatus = status;
+		WdfWaitLockRelease(devContext->OutputLock);
+	}
+
+	if (blob != NULL) {
+		ExFreePoolWithTag(blob, HAPTICS_POOL_TAG);
+	}
+
+	return status;
+}
+
+VOID
+SamsungHapticsLibraryRelease(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PCSAMSUNG_HAPTICS_LIBRARY previous;
+
+	PAGED_CODE();
+
+	previous = devContext->Library.Table;
+	devContext->Library.Table = NULL;
+
+	if (previous != NULL) {
+		ExFreePoolWithTag((PVOID)previous, HAPTICS_POOL_TAG);
+	}
+}
+
+NTSTATUS
+SamsungHapticsLibraryPlay(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ const SAMSUNG_HAPTICS_PLAY_EFFECT* Play
+)
+/*++
+Routine Description:
+
+	Start a library effect on a timed voice, scaled by the requested
+	intensity, from its compiled schedule.
+
+--*/
+{
+	PCSAMSUNG_HAPTICS_LIBRARY table;
+	PCSAMSUNG_HAPTICS_SCHEDULE schedule;
+	ULONG effectId = Play->EffectId;
+	NTSTATUS status;
+
+	PAGED_CODE();
+
+	if (Play->Priority >= SamsungHapticsPriorityMaximum ||
+		Play->PreemptPolicy >= SamsungHapticsPreemptMaximum) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	table = devContext->Library.Table;
+
+	if (table == NULL || effectId == 0 || effectId > SAMSUNG_HAPTICS_LIBRARY_MAX_ID ||
+		table->Index[effectId].Count == 0) {
+		devContext->Library.UnknownIds++;
+		status = STATUS_NOT_FOUND;
+		goto exit;
+	}
+
+	devContext->Library.Plays++;
+
+	schedule = SamsungHapticsScheduleLookup(
+		devContext,
+		effectId,
+		Play->Intensity,
+		&table->Steps[table->Index[effectId].First],
+		table->Index[effectId].Count);
+	if (schedule != NULL) {
+		status = SamsungHapticsMixerSetSequence(
+			devContext,
+			SamsungHapticsVoiceTimed,
+			schedule->Steps,
+			schedule->StepCount,
+			0,
+			(SAMSUNG_HAPTICS_PRIORITY)Play->Priority,
+			(SAMSUNG_HAPTICS_PREEMPT_POLICY)Play->PreemptPolicy);
+		goto exit;
+	}
+
+	//
+	// Every compiled schedule is being played: walk the library steps.
+	//
+	status = SamsungHapticsMixerSetSequence(
+		devContext,
+		SamsungHapticsVoiceTimed,
+		&table->Steps[table->Index[effectId].First],
+		table->Index[effectId].Count,
+		Play->Intensity,
+		(SAMSUNG_HAPTICS_PRIORITY)Play->Priority,
+		(SAMSUNG_HAPTICS_PREEMPT_POLICY)Play->PreemptPolicy);
+
+exit:
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	return status;
+}
+
+VOID
+SamsungHapticsLibraryQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_LIBRARY_STATISTICS Statistics
+)
+{
+	PCSAMSUNG_HAPTICS_LIBRARY table;
+
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	table = devContext->Library.Table;
+
+	Statistics->LoadStatus = devContext->Library.LoadStatus;
+	Statistics->Effects = (table != NULL) ? table->Effects : 0;
+	Statistics->Steps = (table != NULL) ? table->StepCount : 0;
+	Statistics->FootprintBytes = (table != NULL) ? table->Footprint : 0;
+	Statistics->Plays = devContext->Library.Plays;
+	Statistics->UnknownIds = devContext->Library.UnknownIds;
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
@@ -0,0 +1,79 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Library.h
+
+Abstract:
+
+	Preloaded effect library definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+typedef struct _SAMSUNG_HAPTICS_LIBRARY_SPAN
+{
+	USHORT First;            // index of the first step in Steps
+	USHORT Count;            // 0 when the id is not defined
+} SAMSUNG_HAPTICS_LIBRARY_SPAN;
+
+//
+// Immutable nonpaged table built once per load, swapped under OutputLock.
+// Steps of every effect are stored back to back.
+//
+typedef struct _SAMSUNG_HAPTICS_LIBRARY
+{
+	ULONG Effects;
+	ULONG Footprint;         // bytes allocated for this block
+	SAMSUNG_HAPTICS_LIBRARY_SPAN Index[SAMSUNG_HAPTICS_LIBRARY_MAX_ID + 1];
+	ULONG StepCount;
+	SAMSUNG_HAPTICS_LIBRARY_STEP Steps[ANYSIZE_ARRAY];
+} SAMSUNG_HAPTICS_LIBRARY, * PSAMSUNG_HAPTICS_LIBRARY;
+
+typedef const SAMSUNG_HAPTICS_LIBRARY* PCSAMSUNG_HAPTICS_LIBRARY;
+
+typedef struct _SAMSUNG_HAPTICS_LIBRARY_STATE
+{
+	PCSAMSUNG_HAPTICS_LIBRARY Table; // NULL when no library is loaded
+	NTSTATUS LoadStatus;
+	ULONG    Plays;
+	ULONG    UnknownIds;
+} SAMSUNG_HAPTICS_LIBRARY_STATE, * PSAMSUNG_HAPTICS_LIBRARY_STATE;
+
+struct _DEVICE_CONTEXT;
+
+NTSTATUS
+SamsungHapticsLibraryLoad(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsLibraryRelease(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+NTSTATUS
+SamsungHapticsLibraryPlay(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ const SAMSUNG_HAPTICS_PLAY_EFFECT* Play
+);
+
+VOID
+SamsungHapticsLibraryQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_LIBRARY_STATISTICS Statistics
+);
+
+EXTERN_C_END
@@ -0,0 +1,550 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Mixer.c - Mixing of overlapping effects on a motor
+
+Abstract:
+
+	HwnClx funnels every app through the same HwN node, and the audio
+	envelope and control clients drive the same motor. Instead of the last
+	request winning, each source plays into a voice of a small fixed set.
+	Whenever a voice starts, changes or ends, the intensities of the active
+	voices are summed, saturating at full drive, and the effect engine is
+	moved to the mix.
+
+	Voices carry a priority. Only the voices of the highest active priority
+	are mixed; lower ones are preempted on the spot and, by their policy,
+	either resume once the higher priority is gone or are retired. Since a
+	remix runs inline with the request, and play requests are not queued
+	behind other control requests, a critical effect reaches the pin after
+	at most one wait for OutputLock, which is held for a single pin write
+	or tick at a time. The latency of critical requests that ran next to a
+	slower control request is kept apart to show that this holds.
+
+	HwN and audio each own at most one voice, held until the source turns
+	it off. Whenever the mixer silences, resumes or retires the HwN voice
+	on its own, the cached HwN state follows, so GetState matches the
+	motor. Timed voices from IOCTL_SAMSUNG_HAPTICS_PLAY take any free slot,
+	replacing the timed voice closest to its end when none is free, and
+	are retired by the effect timer. A timed voice can instead play a
+	sequence from the effect library, stepping through it in place as each
+	step ends.
+
+	All routines but the IOCTL handlers run with OutputLock held.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "hwndefs.h"
+#include "mixer.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsMixerPlay)
+#pragma alloc_text (PAGE, SamsungHapticsMixerQuery)
+#endif
+
+VOID
+SamsungHapticsMixerInitialize(
+	_Out_ PSAMSUNG_HAPTICS_MIXER Mixer
+)
+{
+	RtlZeroMemory(Mixer, sizeof(*Mixer));
+}
+
+static
+VOID
+SamsungHapticsMixerHwnState(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ const SAMSUNG_HAPTICS_VOICE* Voice,
+	_In_ HWN_STATE HwnState
+)
+/*++
+Routine Description:
+
+	Record a change the mixer made to the HwN voice in the state reported
+	to HwnClx. Other voices are ignored.
+
+--*/
+{
+	if (Voice->Source != SamsungHapticsVoiceHwn || devContext->PreviousState == HwnState) {
+		return;
+	}
+
+	devContext->PreviousState = HwnState;
+	SamsungHapticsHwnStateSync(devContext);
+}
+
+static
+NTSTATUS
+SamsungHapticsMixerRemix(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Sum the active voices and hand the result to the effect engine if it
+	changed. The effect timer is always re-armed since the earliest voice
+	end may have moved.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MIXER mixer = &devContext->Mixer;
+	NTSTATUS status = STATUS_SUCCESS;
+	SAMSUNG_HAPTICS_PRIORITY top = SamsungHapticsPriorityLow;
+	ULONG output = 0;
+	ULONGLONG nextEnd = MAXULONG64;
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		if (mixer->Voices[i].Source != SamsungHapticsVoiceFree) {
+			top = max(top, mixer->Voices[i].Priority);
+		}
+	}
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		PSAMSUNG_HAPTICS_VOICE voice = &mixer->Voices[i];
+
+		if (voice->Source == SamsungHapticsVoiceFree) {
+			continue;
+		}
+
+		if (voice->Priority < top) {
+			if (voice->Policy == SamsungHapticsPreemptDrop) {
+				SamsungHapticsMixerHwnState(devContext, voice, HWN_OFF);
+				voice->Source = SamsungHapticsVoiceFree;
+				mixer->Dropped++;
+				continue;
+			}
+
+			if (!voice->Preempted) {
+				SamsungHapticsMixerHwnState(devContext, voice, HWN_OFF);
+				voice->Preempted = TRUE;
+				mixer->Preemptions++;
+			}
+		}
+		else {
+			if (voice->Preempted) {
+				SamsungHapticsMixerHwnState(devContext, voice, HWN_ON);
+				voice->Preempted = FALSE;
+			}
+
+			output = min(output + voice->Intensity, SAMSUNG_HAPTICS_MAX_INTENSITY);
+		}
+
+		if (voice->EndTime != 0) {
+			nextEnd = min(nextEnd, voice->EndTime);
+		}
+	}
+
+	mixer->NextEnd = (nextEnd != MAXULONG64) ? nextEnd : 0;
+	mixer->Mixes++;
+
+	if (devContext->Stopped) {
+		//
+		// Outside D0 the voices are only recorded; the mix is applied
+		// when the device restarts.
+		//
+		return STATUS_SUCCESS;
+	}
+
+	if (output != mixer->Output) {
+		mixer->Output = output;
+		status = (output != 0) ?
+			SamsungHapticsEffectOn(devContext, output) :
+			SamsungHapticsEffectOff(devContext);
+	}
+
+	SamsungHapticsEffectReschedule(devContext);
+
+	return status;
+}
+
+static
+PSAMSUNG_HAPTICS_VOICE
+SamsungHapticsMixerAllocateVoice(
+	_Inout_ PSAMSUNG_HAPTICS_MIXER Mixer,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source,
+	_In_ SAMSUNG_HAPTICS_PRIORITY Priority
+)
+/*++
+Routine Description:
+
+	Find the slot for a new voice: the source's own voice for HwN and
+	audio, else a free slot, else the timed voice of lowest priority that
+	is closest to its end, provided it does not outrank the new voice.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_VOICE freeVoice = NULL;
+	PSAMSUNG_HAPTICS_VOICE victim = NULL;
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		PSAMSUNG_HAPTICS_VOICE voice = &Mixer->Voices[i];
+
+		if (Source != SamsungHapticsVoiceTimed && voice->Source == Source) {
+			return voice;
+		}
+
+		if (voice->Source == SamsungHapticsVoiceFree) {
+			if (freeVoice == NULL) {
+				freeVoice = voice;
+			}
+		}
+		else if (voice->Source == SamsungHapticsVoiceTimed && voice->Priority <= Priority) {
+			if (victim == NULL ||
+				voice->Priority < victim->Priority ||
+				(voice->Priority == victim->Priority && voice->EndTime < victim->EndTime)) {
+				victim = voice;
+			}
+		}
+	}
+
+	if (freeVoice != NULL) {
+		return freeVoice;
+	}
+
+	if (victim != NULL) {
+		Mixer->Stolen++;
+	}
+
+	return victim;
+}
+
+NTSTATUS
+SamsungHapticsMixerSetVoice(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source,
+	_In_ ULONG Intensity,
+	_In_ ULONG DurationMs,
+	_In_ SAMSUNG_HAPTICS_PRIORITY Priority,
+	_In_ SAMSUNG_HAPTICS_PREEMPT_POLICY Policy
+)
+/*++
+Routine Description:
+
+	Start or update the voice of a source. An intensity of 0 keeps its
+	historical HwN meaning of full drive; a duration of 0 holds the voice
+	until it is cleared.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_VOICE voice;
+
+	voice = SamsungHapticsMixerAllocateVoice(&devContext->Mixer, Source, Priority);
+	if (voice == NULL) {
+		return STATUS_DEVICE_BUSY;
+	}
+
+	voice->Source = Source;
+	voice->Intensity = (Intensity == 0) ? SAMSUNG_HAPTICS_MAX_INTENSITY : min(Intensity, SAMSUNG_HAPTICS_MAX_INTENSITY);
+	voice->EndTime = (DurationMs != 0) ? KeQueryInterruptTime() + (ULONGLONG)DurationMs * 10000 : 0;
+	voice->Priority = Priority;
+	voice->Policy = Policy;
+	voice->Preempted = FALSE;
+	voice->Step = NULL;
+	voice->StepsLeft = 0;
+
+	return SamsungHapticsMixerRemix(devContext);
+}
+
+static
+ULONG
+SamsungHapticsMixerStepIntensity(
+	_In_ const SAMSUNG_HAPTICS_VOICE* Voice
+)
+{
+	if (Voice->Scale == 0 || Voice->Scale >= SAMSUNG_HAPTICS_MAX_INTENSITY) {
+		return Voice->Step->Intensity;
+	}
+
+	return (Voice->Step->Intensity * Voice->Scale + SAMSUNG_HAPTICS_MAX_INTENSITY - 1) / SAMSUNG_HAPTICS_MAX_INTENSITY;
+}
+
+NTSTATUS
+SamsungHapticsMixerSetSequence(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source,
+	_In_reads_(StepCount) const SAMSUNG_HAPTICS_LIBRARY_STEP* Steps,
+	_In_ ULONG StepCount,
+	_In_ ULONG Intensity,
+	_In_ SAMSUNG_HAPTICS_PRIORITY Priority,
+	_In_ SAMSUNG_HAPTICS_PREEMPT_POLICY Policy
+)
+/*++
+Routine Description:
+
+	Start a voice playing a sequence of steps, which must stay valid until
+	the voice ends or SamsungHapticsMixerStopSequences is called. An
+	intensity of 0 plays the steps as authored. A step intensity of 0 is a
+	pause: the voice stays allocated but adds nothing to the mix.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_VOICE voice;
+
+	voice = SamsungHapticsMixerAllocateVoice(&devContext->Mixer, Source, Priority);
+	if (voice == NULL) {
+		return STATUS_DEVICE_BUSY;
+	}
+
+	voice->Source = Source;
+	voice->Step = Steps;
+	voice->StepsLeft = StepCount - 1;
+	voice->Scale = Intensity;
+	voice->Intensity = SamsungHapticsMixerStepIntensity(voice);
+	voice->EndTime = KeQueryInterruptTime() + (ULONGLONG)Steps->DurationMs * 10000;
+	voice->Priority = Priority;
+	voice->Policy = Policy;
+	voice->Preempted = FALSE;
+
+	return SamsungHapticsMixerRemix(devContext);
+}
+
+VOID
+SamsungHapticsMixerStopSequences(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Retire every voice playing a sequence, before the steps it points to
+	are freed. Must be called with OutputLock held.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MIXER mixer = &devContext->Mixer;
+	BOOLEAN stopped = FALSE;
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		if (mixer->Voices[i].Source != SamsungHapticsVoiceFree && mixer->Voices[i].Step != NULL) {
+			SamsungHapticsMixerHwnState(devContext, &mixer->Voices[i], HWN_OFF);
+			mixer->Voices[i].Source = SamsungHapticsVoiceFree;
+			mixer->Voices[i].Step = NULL;
+			stopped = TRUE;
+		}
+	}
+
+	if (stopped) {
+		SamsungHapticsMixerRemix(devContext);
+	}
+}
+
+NTSTATUS
+SamsungHapticsMixerClearVoice(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source
+)
+{
+	PSAMSUNG_HAPTICS_MIXER mixer = &devContext->Mixer;
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		if (mixer->Voices[i].Source == Source) {
+			mixer->Voices[i].Source = SamsungHapticsVoiceFree;
+		}
+	}
+
+	return SamsungHapticsMixerRemix(devContext);
+}
+
+BOOLEAN
+SamsungHapticsMixerVoicePreempted(
+	_In_ PDEVICE_CONTEXT devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source
+)
+{
+	PSAMSUNG_HAPTICS_MIXER mixer = &devContext->Mixer;
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		if (mixer->Voices[i].Source == Source && mixer->Voices[i].Preempted) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+VOID
+SamsungHapticsMixerExpire(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONGLONG Now
+)
+/*++
+Routine Description:
+
+	Retire the voices that reached their end time, or move sequences on to
+	their next step. Step ends are chained from the previous end rather
+	than from Now, so a late timer does not stretch the sequence. Called
+	from the effect timer.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MIXER mixer = &devContext->Mixer;
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		PSAMSUNG_HAPTICS_VOICE voice = &mixer->Voices[i];
+
+		if (voice->Source == SamsungHapticsVoiceFree || voice->EndTime == 0) {
+			continue;
+		}
+
+		while (voice->Step != NULL && voice->StepsLeft != 0 && Now >= voice->EndTime) {
+			voice->Step++;
+			voice->StepsLeft--;
+			voice->Intensity = SamsungHapticsMixerStepIntensity(voice);
+			voice->EndTime += (ULONGLONG)voice->Step->DurationMs * 10000;
+		}
+
+		if (Now >= voice->EndTime) {
+			SamsungHapticsMixerHwnState(devContext, voice, HWN_OFF);
+			voice->Source = SamsungHapticsVoiceFree;
+			voice->Step = NULL;
+			mixer->Retired++;
+		}
+	}
+
+	SamsungHapticsMixerRemix(devContext);
+}
+
+VOID
+SamsungHapticsMixerQuiesce(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Silence the motor on D0 exit. The voices are kept so they can resume.
+	Must be called with OutputLock held, after Stopped is set.
+
+--*/
+{
+	devContext->Mixer.Output = 0;
+	SamsungHapticsEffectQuiesce(devContext);
+}
+
+NTSTATUS
+SamsungHapticsMixerRestore(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Apply the voices on D0 entry, after timed voices that ended while the
+	device was stopped are retired. The pin may have lost its level across
+	the transition, so it is written exactly once: by the effect engine if
+	the mix is audible, low otherwise. Must be called with OutputLock held,
+	after Stopped is cleared.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MIXER mixer = &devContext->Mixer;
+	NTSTATUS status;
+
+	SamsungHapticsMixerExpire(devContext, KeQueryInterruptTime());
+
+	if (mixer->Output != 0) {
+		return STATUS_SUCCESS;
+	}
+
+	status = GpioWritePin(devContext, 0);
+	SamsungHapticsEffectReschedule(devContext);
+
+	return status;
+}
+
+NTSTATUS
+SamsungHapticsMixerPlay(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ const SAMSUNG_HAPTICS_PLAY* Play
+)
+{
+	NTSTATUS status;
+	LARGE_INTEGER start;
+	BOOLEAN contended;
+
+	PAGED_CODE();
+
+	if (Play->DurationMs == 0 || Play->DurationMs > SAMSUNG_HAPTICS_MAX_PLAY_MS ||
+		Play->Priority >= SamsungHapticsPriorityMaximum ||
+		Play->PreemptPolicy >= SamsungHapticsPreemptMaximum) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	start = KeQueryPerformanceCounter(NULL);
+	contended = SamsungHapticsControlSerialBusy();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	status = SamsungHapticsMixerSetVoice(
+		devContext,
+		SamsungHapticsVoiceTimed,
+		Play->Intensity,
+		Play->DurationMs,
+		(SAMSUNG_HAPTICS_PRIORITY)Play->Priority,
+		(SAMSUNG_HAPTICS_PREEMPT_POLICY)Play->PreemptPolicy);
+
+	if (NT_SUCCESS(status) && Play->Priority == SamsungHapticsPriorityCritical) {
+		ULONGLONG elapsed = SamsungHapticsElapsedUs(start);
+
+		SamsungHapticsLatencyAdd(&devContext->Mixer.CriticalLatency, elapsed);
+		if (contended) {
+			SamsungHapticsLatencyAdd(&devContext->Mixer.CriticalContended, elapsed);
+		}
+	}
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	return status;
+}
+
+VOID
+SamsungHapticsMixerQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_MIXER_STATISTICS Statistics
+)
+{
+	PSAMSUNG_HAPTICS_MIXER mixer = &devContext->Mixer;
+	ULONGLONG now;
+	ULONG i;
+
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	now = KeQueryInterruptTime();
+
+	Statistics->Output = mixer->Output;
+	Statistics->Reserved = 0;
+	Statistics->Mixes = mixer->Mixes;
+	Statistics->Retired = mixer->Retired;
+	Statistics->Stolen = mixer->Stolen;
+	Statistics->Preemptions = mixer->Preemptions;
+	Statistics->Dropped = mixer->Dropped;
+	Statistics->CriticalLatency = mixer->CriticalLatency;
+	Statistics->CriticalContended = mixer->CriticalContended;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		PSAMSUNG_HAPTICS_VOICE voice = &mixer->Voices[i];
+
+		Statistics->Voices[i].Source = voice->Source;
+		Statistics->Voices[i].Intensity = (voice->Source != SamsungHapticsVoiceFree) ? voice->Intensity : 0;
+		Statistics->Voices[i].RemainingMs = (voice->Source != SamsungHapticsVoiceFree && voice->EndTime > now) ?
+			(ULONG)((voice->EndTime - now) / 10000) : 0;
+		Statistics->Voices[i].Priority = voice->Priority;
+		Statistics->Voices[i].Preempted = voice->Preempted;
+	}
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
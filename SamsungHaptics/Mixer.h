@@ -0,0 +1,134 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Mixer.h
+
+Abstract:
+
+	Effect voice mixer definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+typedef struct _SAMSUNG_HAPTICS_VOICE
+{
+	SAMSUNG_HAPTICS_VOICE_SOURCE Source;
+	ULONG     Intensity;        // requested intensity, 1 to SAMSUNG_HAPTICS_MAX_INTENSITY
+	ULONGLONG EndTime;          // interrupt time, 0 for no end
+	SAMSUNG_HAPTICS_PRIORITY       Priority;
+	SAMSUNG_HAPTICS_PREEMPT_POLICY Policy;
+	BOOLEAN   Preempted;        // silenced by a higher priority voice
+
+	//
+	// Library sequence being played, NULL for a constant voice. EndTime is
+	// the end of the current step; Scale is the requested intensity the
+	// steps are scaled by.
+	//
+	const SAMSUNG_HAPTICS_LIBRARY_STEP* Step;
+	ULONG     StepsLeft;        // steps after the current one
+	ULONG     Scale;
+} SAMSUNG_HAPTICS_VOICE, * PSAMSUNG_HAPTICS_VOICE;
+
+typedef struct _SAMSUNG_HAPTICS_MIXER
+{
+	SAMSUNG_HAPTICS_VOICE Voices[SAMSUNG_HAPTICS_MIXER_VOICES];
+
+	ULONG     Output;           // mixed intensity handed to the effect engine
+	ULONGLONG NextEnd;          // earliest voice end time, 0 when none
+
+	ULONGLONG Mixes;
+	ULONGLONG Retired;
+	ULONGLONG Stolen;
+	ULONGLONG Preemptions;
+	ULONGLONG Dropped;
+	SAMSUNG_HAPTICS_LATENCY CriticalLatency;
+	SAMSUNG_HAPTICS_LATENCY CriticalContended;
+} SAMSUNG_HAPTICS_MIXER, * PSAMSUNG_HAPTICS_MIXER;
+
+struct _DEVICE_CONTEXT;
+
+VOID
+SamsungHapticsMixerInitialize(
+	_Out_ PSAMSUNG_HAPTICS_MIXER Mixer
+);
+
+NTSTATUS
+SamsungHapticsMixerSetVoice(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source,
+	_In_ ULONG Intensity,
+	_In_ ULONG DurationMs,
+	_In_ SAMSUNG_HAPTICS_PRIORITY Priority,
+	_In_ SAMSUNG_HAPTICS_PREEMPT_POLICY Policy
+);
+
+NTSTATUS
+SamsungHapticsMixerSetSequence(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source,
+	_In_reads_(StepCount) const SAMSUNG_HAPTICS_LIBRARY_STEP* Steps,
+	_In_ ULONG StepCount,
+	_In_ ULONG Intensity,
+	_In_ SAMSUNG_HAPTICS_PRIORITY Priority,
+	_In_ SAMSUNG_HAPTICS_PREEMPT_POLICY Policy
+);
+
+VOID
+SamsungHapticsMixerStopSequences(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+NTSTATUS
+SamsungHapticsMixerClearVoice(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source
+);
+
+BOOLEAN
+SamsungHapticsMixerVoicePreempted(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_In_ SAMSUNG_HAPTICS_VOICE_SOURCE Source
+);
+
+VOID
+SamsungHapticsMixerExpire(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONGLONG Now
+);
+
+VOID
+SamsungHapticsMixerQuiesce(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+NTSTATUS
+SamsungHapticsMixerRestore(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+NTSTATUS
+SamsungHapticsMixerPlay(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ const SAMSUNG_HAPTICS_PLAY* Play
+);
+
+VOID
+SamsungHapticsMixerQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_MIXER_STATISTICS Statistics
+);
+
+EXTERN_C_END
@@ -0,0 +1,325 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Modulator.c - Sigma-delta intensity modulation of the enable pin
+
+Abstract:
+
+	A DC vibrator has a single enable pin, so intensity can only be produced
+	by switching it. Plain PWM at a fixed carrier writes the pin twice per
+	period whatever the intensity. The first-order sigma-delta modulator
+	here runs at a configurable tick rate and only issues a pin write when
+	its output bit changes, so the IOCTL rate follows the intensity: full
+	and low intensities toggle rarely, 50% toggles every tick.
+
+	Each pin write is a synchronous IOCTL and must be issued at
+	PASSIVE_LEVEL; ticks come from the device's output timer backend, which
+	runs the tick on its own real-time priority thread.
+
+	All pin writes, modulated or not, are serialized by OutputLock.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "modulator.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsModulatorInitialize)
+#pragma alloc_text (PAGE, SamsungHapticsModulatorUninitialize)
+#pragma alloc_text (PAGE, SamsungHapticsModulatorConfigure)
+#pragma alloc_text (PAGE, SamsungHapticsModulatorQuery)
+#endif
+
+#define MODULATOR_TICK_PERIOD(TickRate) (10000000LL / (TickRate))
+
+static
+VOID
+SamsungHapticsModulatorTick(
+	_In_ PVOID Context
+)
+/*++
+Routine Description:
+
+	Run one modulator tick. The intensity is added to the accumulator; the
+	output bit is set whenever the accumulator overflows
+	SAMSUNG_HAPTICS_MAX_INTENSITY, and the pin is written only when the bit
+	differs from the current pin level.
+
+--*/
+{
+	PDEVICE_CONTEXT devContext = (PDEVICE_CONTEXT)Context;
+	PSAMSUNG_HAPTICS_MODULATOR modulator = &devContext->Modulator;
+	LONG intensity;
+	UCHAR level;
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	intensity = ReadNoFence(&modulator->Intensity);
+	if (intensity != 0)
+	{
+		modulator->Accumulator += intensity;
+		if (modulator->Accumulator >= SAMSUNG_HAPTICS_MAX_INTENSITY)
+		{
+			modulator->Accumulator -= SAMSUNG_HAPTICS_MAX_INTENSITY;
+			level = 1;
+		}
+		else
+		{
+			level = 0;
+		}
+
+		if (level != devContext->PinLevel)
+		{
+			GpioWritePin(devContext, level);
+			InterlockedIncrement64(&modulator->PinWrites);
+		}
+
+		InterlockedIncrement64(&modulator->Ticks);
+	}
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
+
+NTSTATUS
+SamsungHapticsModulatorInitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Set up the tick timer. The modulator starts disabled; intensity is
+	ignored until it is configured.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MODULATOR modulator = &devContext->Modulator;
+
+	PAGED_CODE();
+
+	RtlZeroMemory(modulator, sizeof(*modulator));
+	modulator->Modulation = SamsungHapticsModulationNone;
+	modulator->TickRate = SAMSUNG_HAPTICS_MODULATOR_DEFAULT_TICK_RATE;
+
+	return SamsungHapticsTimerInitialize(&modulator->Timer, SamsungHapticsModulatorTick, devContext);
+}
+
+VOID
+SamsungHapticsModulatorUninitialize(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PAGED_CODE();
+
+	SamsungHapticsTimerUninitialize(&devContext->Modulator.Timer);
+}
+
+BOOLEAN
+SamsungHapticsModulatorStart(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONG Intensity
+)
+/*++
+Routine Description:
+
+	Hand the pin to the modulator for a partial intensity. Must be called
+	with OutputLock held.
+
+Return Value:
+
+	TRUE if the modulator now drives the pin, FALSE if the caller should
+	drive it directly (modulation disabled, or a full/zero intensity).
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MODULATOR modulator = &devContext->Modulator;
+
+	if (modulator->Modulation != SamsungHapticsModulationSigmaDelta ||
+		Intensity == 0 ||
+		Intensity >= SAMSUNG_HAPTICS_MAX_INTENSITY)
+	{
+		SamsungHapticsModulatorStop(devContext);
+		return FALSE;
+	}
+
+	InterlockedExchange(&modulator->Intensity, (LONG)Intensity);
+
+	if (!modulator->TimerRunning)
+	{
+		LONGLONG period = MODULATOR_TICK_PERIOD(modulator->TickRate);
+
+		modulator->Accumulator = 0;
+		modulator->TimerRunning = TRUE;
+		SamsungHapticsTimerSet(&modulator->Timer, period, period);
+	}
+
+	return TRUE;
+}
+
+VOID
+SamsungHapticsModulatorStop(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Take the pin back from the modulator. Must be called with OutputLock
+	held; the pin is left at whatever level the last tick wrote.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MODULATOR modulator = &devContext->Modulator;
+
+	InterlockedExchange(&modulator->Intensity, 0);
+
+	if (modulator->TimerRunning)
+	{
+		SamsungHapticsTimerCancel(&modulator->Timer);
+		modulator->TimerRunning = FALSE;
+	}
+}
+
+NTSTATUS
+SamsungHapticsModulatorConfigure(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ const SAMSUNG_HAPTICS_MODULATOR_CONFIG* Config
+)
+/*++
+Routine Description:
+
+	Set the modulation and carrier rate. The rate is capped at what the
+	pin path was calibrated to sustain, whoever asks for it.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_MODULATOR modulator = &devContext->Modulator;
+	NTSTATUS status = STATUS_SUCCESS;
+	ULONG tickRate;
+
+	PAGED_CODE();
+
+	if (Config->Modulation >= SamsungHapticsModulationMaximum ||
+		Config->TickRate < SAMSUNG_HAPTICS_MODULATOR_MIN_TICK_RATE ||
+		Config->TickRate > SAMSUNG_HAPTICS_MODULATOR_MAX_TICK_RATE)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	modulator->Modulation = (SAMSUNG_HAPTICS_MODULATION)Config->Modulation;
+	tickRate = SamsungHapticsCalibrationCarrier(devContext, Config->TickRate);
+	modulator->TickRate = tickRate;
+
+	if (modulator->TimerRunning)
+	{
+		if (modulator->Modulation == SamsungHapticsModulationSigmaDelta)
+		{
+			LONGLONG period = MODULATOR_TICK_PERIOD(modulator->TickRate);
+
+			SamsungHapticsTimerSet(&modulator->Timer, period, period);
+		}
+		else
+		{
+			//
+			// Modulation switched off mid-effect: the motor was requested
+			// on, so fall back to driving it fully on.
+			//
+			SamsungHapticsModulatorStop(devContext);
+			status = GpioWritePin(devContext, 1);
+		}
+	}
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_HAPTICS,
+		"Modulator configured: mode %u, %u ticks/s of %u requested",
+		Config->Modulation,
+		tickRate,
+		Config->TickRate);
+
+	return status;
+}
+
+static
+ULONG
+SamsungHapticsModulatorTogglesPerPeriod(
+	_In_ ULONG Intensity
+)
+/*++
+Routine Description:
+
+	Count output changes of the modulator over one full period of
+	SAMSUNG_HAPTICS_MAX_INTENSITY ticks at a constant intensity, including
+	the change across the period boundary.
+
+--*/
+{
+	LONG accumulator = 0;
+	UCHAR first = 0;
+	UCHAR previous = 0;
+	ULONG toggles = 0;
+	ULONG tick;
+
+	for (tick = 0; tick < SAMSUNG_HAPTICS_MAX_INTENSITY; tick++)
+	{
+		UCHAR level = 0;
+
+		accumulator += (LONG)Intensity;
+		if (accumulator >= SAMSUNG_HAPTICS_MAX_INTENSITY)
+		{
+			accumulator -= SAMSUNG_HAPTICS_MAX_INTENSITY;
+			level = 1;
+		}
+
+		if (tick == 0)
+		{
+			first = level;
+		}
+		else if (level != previous)
+		{
+			toggles++;
+		}
+
+		previous = level;
+	}
+
+	if (previous != first)
+	{
+		toggles++;
+	}
+
+	return toggles;
+}
+
+VOID
+SamsungHapticsModulatorQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_MODULATOR_STATISTICS Statistics
+)
+{
+	PSAMSUNG_HAPTICS_MODULATOR modulator = &devContext->Modulator;
+	ULONG intensity;
+
+	PAGED_CODE();
+
+	Statistics->Modulation = modulator->Modulation;
+	Statistics->TickRate = modulator->TickRate;
+	Statistics->Ticks = (ULONGLONG)ReadNoFence64(&modulator->Ticks);
+	Statistics->PinWrites = (ULONGLONG)ReadNoFence64(&modulator->PinWrites);
+
+	for (intensity = 0; intensity <= SAMSUNG_HAPTICS_MAX_INTENSITY; intensity++)
+	{
+		Statistics->TogglesPerSecond[intensity] =
+			SamsungHapticsModulatorTogglesPerPeriod(intensity) * modulator->TickRate / SAMSUNG_HAPTICS_MAX_INTENSITY;
+	}
+}
@@ -0,0 +1,83 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Modulator.h
+
+Abstract:
+
+	Intensity modulator definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+#include "timer.h"
+
+EXTERN_C_START
+
+#define SAMSUNG_HAPTICS_MODULATOR_DEFAULT_TICK_RATE 1000
+
+typedef struct _SAMSUNG_HAPTICS_MODULATOR
+{
+	SAMSUNG_HAPTICS_MODULATION Modulation;
+	ULONG          TickRate;
+
+	//
+	// Requested intensity in percent. Zero means the modulator is idle and
+	// the pin belongs to the plain on/off path.
+	//
+	volatile LONG  Intensity;
+	LONG           Accumulator;
+	BOOLEAN        TimerRunning;
+
+	SAMSUNG_HAPTICS_TIMER Timer;
+
+	volatile LONG64 Ticks;
+	volatile LONG64 PinWrites;
+} SAMSUNG_HAPTICS_MODULATOR, * PSAMSUNG_HAPTICS_MODULATOR;
+
+struct _DEVICE_CONTEXT;
+
+NTSTATUS
+SamsungHapticsModulatorInitialize(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsModulatorUninitialize(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+NTSTATUS
+SamsungHapticsModulatorConfigure(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ const SAMSUNG_HAPTICS_MODULATOR_CONFIG* Config
+);
+
+BOOLEAN
+SamsungHapticsModulatorStart(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONG Intensity
+);
+
+VOID
+SamsungHapticsModulatorStop(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsModulatorQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_MODULATOR_STATISTICS Statistics
+);
+
+EXTERN_C_END
@@ -0,0 +1,225 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Motor.c - First-order ERM motor model
+
+Abstract:
+
+	Output changes such as modulation, coalescing or kick pulses trade CPU
+	cost against what the user actually feels, and the pin trace alone does
+	not show the latter. This module feeds the real pin edges into a
+	first-order model of the eccentric rotating mass motor: rotor speed
+	relaxes exponentially towards rated speed while the pin is high and
+	towards zero while it is low, with separate spin-up and spin-down time
+	constants. Vibration amplitude of an ERM grows with the square of the
+	rotor speed, so that is what is reported as acceleration.
+
+	Per effect the model records rise and fall times and peak and mean
+	acceleration, so an output change can be checked for perceived quality
+	as well as for cost. The model is only touched under OutputLock.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+
+#define MOTOR_Q16_ONE        65536
+#define MOTOR_RISE_THRESHOLD ((MOTOR_Q16_ONE * 9) / 10)
+#define MOTOR_FALL_THRESHOLD (MOTOR_Q16_ONE / 10)
+#define MOTOR_STEP           10000      // 1 ms in 100 ns units
+#define MOTOR_SETTLED        16         // speed error treated as converged
+#define MOTOR_MAX_FALL       50000000   // 5 s
+
+static
+LONG
+SamsungHapticsMotorModelStep(
+	_In_ LONG Speed,
+	_In_ LONG Target,
+	_In_ ULONG TimeConstantMs,
+	_In_ ULONGLONG Step
+)
+/*++
+Routine Description:
+
+	Advance the speed by one Euler step of at most MOTOR_STEP towards the
+	target. The step is small relative to any realistic time constant.
+
+--*/
+{
+	LONGLONG tau = (LONGLONG)TimeConstantMs * 10000;
+
+	if (tau <= (LONGLONG)Step)
+	{
+		return Target;
+	}
+
+	return Speed + (LONG)(((LONGLONG)(Target - Speed) * (LONGLONG)Step) / tau);
+}
+
+static
+VOID
+SamsungHapticsMotorModelAdvance(
+	_Inout_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model,
+	_In_ ULONGLONG Now
+)
+{
+	ULONGLONG elapsed;
+	ULONGLONG time;
+	LONG target = Model->Level ? MOTOR_Q16_ONE : 0;
+	ULONG tau = Model->Level ? Model->SpinUpMs : Model->SpinDownMs;
+
+	if (Now <= Model->LastTime)
+	{
+		return;
+	}
+
+	elapsed = Now - Model->LastTime;
+	time = Model->LastTime;
+
+	while (elapsed != 0)
+	{
+		ULONGLONG step = min(elapsed, MOTOR_STEP);
+		LONG acceleration;
+
+		if (Model->Speed - target < MOTOR_SETTLED && target - Model->Speed < MOTOR_SETTLED)
+		{
+			//
+			// Converged: the rest of the interval contributes at a
+			// constant level.
+			//
+			Model->Speed = target;
+			step = elapsed;
+		}
+		else
+		{
+			Model->Speed = SamsungHapticsMotorModelStep(Model->Speed, target, tau, step);
+		}
+
+		time += step;
+		elapsed -= step;
+
+		if (Model->InEffect)
+		{
+			acceleration = (LONG)(((LONGLONG)Model->Speed * Model->Speed) >> 16);
+			Model->AccelerationSum += (ULONGLONG)acceleration * step;
+			Model->PeakAcceleration = max(Model->PeakAcceleration, acceleration);
+
+			if (Model->RiseTime == 0 && Model->Speed >= MOTOR_RISE_THRESHOLD)
+			{
+				Model->RiseTime = max(time - Model->EffectStart, 1);
+			}
+		}
+	}
+
+	Model->LastTime = Now;
+}
+
+VOID
+SamsungHapticsMotorModelInitialize(
+	_Out_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model
+)
+{
+	RtlZeroMemory(Model, sizeof(*Model));
+	Model->SpinUpMs = SAMSUNG_HAPTICS_MOTOR_DEFAULT_SPIN_UP_MS;
+	Model->SpinDownMs = SAMSUNG_HAPTICS_MOTOR_DEFAULT_SPIN_DOWN_MS;
+	Model->LastTime = KeQueryInterruptTime();
+}
+
+VOID
+SamsungHapticsMotorModelPinChanged(
+	_Inout_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model,
+	_In_ UCHAR Level
+)
+{
+	SamsungHapticsMotorModelAdvance(Model, KeQueryInterruptTimePrecise(NULL));
+	Model->Level = Level;
+
+	if (Model->InEffect)
+	{
+		Model->PinWrites++;
+	}
+}
+
+VOID
+SamsungHapticsMotorModelEffectStart(
+	_Inout_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model
+)
+{
+	ULONGLONG now = KeQueryInterruptTimePrecise(NULL);
+
+	SamsungHapticsMotorModelAdvance(Model, now);
+
+	Model->InEffect = TRUE;
+	Model->EffectStart = now;
+	Model->RiseTime = 0;
+	Model->AccelerationSum = 0;
+	Model->PeakAcceleration = 0;
+	Model->PinWrites = 0;
+}
+
+VOID
+SamsungHapticsMotorModelEffectEnd(
+	_Inout_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model
+)
+/*++
+Routine Description:
+
+	Close the current effect. Called after the pin has been driven low; the
+	fall time is obtained by running the model forward from the current
+	speed with the pin low.
+
+--*/
+{
+	ULONGLONG now = KeQueryInterruptTimePrecise(NULL);
+	ULONGLONG duration;
+	ULONGLONG fall = 0;
+	LONG speed;
+	PSAMSUNG_HAPTICS_MOTOR_EFFECT effect;
+
+	if (!Model->InEffect)
+	{
+		return;
+	}
+
+	SamsungHapticsMotorModelAdvance(Model, now);
+	Model->InEffect = FALSE;
+
+	speed = Model->Speed;
+	while (speed > MOTOR_FALL_THRESHOLD && fall < MOTOR_MAX_FALL)
+	{
+		speed = SamsungHapticsMotorModelStep(speed, 0, Model->SpinDownMs, MOTOR_STEP);
+		fall += MOTOR_STEP;
+	}
+
+	duration = max(now - Model->EffectStart, 1);
+
+	effect = &Model->Effects[Model->EffectCount % SAMSUNG_HAPTICS_MOTOR_EFFECT_HISTORY];
+	effect->DurationUs = (ULONG)min(duration / 10, MAXULONG);
+	effect->RiseTimeUs = (ULONG)min(Model->RiseTime / 10, MAXULONG);
+	effect->FallTimeUs = (ULONG)(fall / 10);
+	effect->PeakAcceleration = (ULONG)(((ULONGLONG)Model->PeakAcceleration * 10000) >> 16);
+	effect->MeanAcceleration = (ULONG)(((Model->AccelerationSum / duration) * 10000) >> 16);
+	effect->PinWrites = Model->PinWrites;
+
+	Model->EffectCount++;
+}
+
+VOID
+SamsungHapticsMotorModelQuery(
+	_In_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model,
+	_Out_ PSAMSUNG_HAPTICS_MOTOR_STATISTICS Statistics
+)
+{
+	Statistics->SpinUpMs = Model->SpinUpMs;
+	Statistics->SpinDownMs = Model->SpinDownMs;
+	Statistics->EffectCount = Model->EffectCount;
+	Statistics->Reserved = 0;
+	RtlCopyMemory(Statistics->Effects, Model->Effects, sizeof(Statistics->Effects));
+}
@@ -0,0 +1,76 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Motor.h
+
+Abstract:
+
+	First-order ERM motor model definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+#define SAMSUNG_HAPTICS_MOTOR_DEFAULT_SPIN_UP_MS   35
+#define SAMSUNG_HAPTICS_MOTOR_DEFAULT_SPIN_DOWN_MS 50
+
+typedef struct _SAMSUNG_HAPTICS_MOTOR_MODEL
+{
+	ULONG     SpinUpMs;
+	ULONG     SpinDownMs;
+
+	LONG      Speed;                // Q16 fraction of rated speed
+	UCHAR     Level;                // pin level driving the model
+	ULONGLONG LastTime;             // interrupt time of the last update
+
+	BOOLEAN   InEffect;
+	ULONGLONG EffectStart;
+	ULONGLONG RiseTime;
+	ULONGLONG AccelerationSum;      // Q16 acceleration integrated over 100ns units
+	LONG      PeakAcceleration;     // Q16
+	ULONG     PinWrites;
+
+	ULONG     EffectCount;
+	SAMSUNG_HAPTICS_MOTOR_EFFECT Effects[SAMSUNG_HAPTICS_MOTOR_EFFECT_HISTORY];
+} SAMSUNG_HAPTICS_MOTOR_MODEL, * PSAMSUNG_HAPTICS_MOTOR_MODEL;
+
+VOID
+SamsungHapticsMotorModelInitialize(
+	_Out_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model
+);
+
+VOID
+SamsungHapticsMotorModelPinChanged(
+	_Inout_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model,
+	_In_ UCHAR Level
+);
+
+VOID
+SamsungHapticsMotorModelEffectStart(
+	_Inout_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model
+);
+
+VOID
+SamsungHapticsMotorModelEffectEnd(
+	_Inout_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model
+);
+
+VOID
+SamsungHapticsMotorModelQuery(
+	_In_ PSAMSUNG_HAPTICS_MOTOR_MODEL Model,
+	_Out_ PSAMSUNG_HAPTICS_MOTOR_STATISTICS Statistics
+);
+
+EXTERN_C_END
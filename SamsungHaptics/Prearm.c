@@ -0,0 +1,177 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Prearm.c - Warming up the output path ahead of an expected effect
+
+Abstract:
+
+	The first effect after the motor has been idle pays for paging in the
+	pageable callback code, for the system timer running at its coarse
+	default resolution and for a GPIO request being allocated. A client
+	that expects an effect soon (for example on touch-down) can pre-arm the
+	device: for the length of a short lease, the pageable section is
+	locked, the timer resolution is raised, the reusable pin write request
+	exists and the GPIO target is verified to be started. When the lease
+	expires, the effect timer relaxes everything but the request.
+
+	Request-to-pin latency of cold effects is recorded with and without a
+	lease so the benefit can be measured on the device.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "hwndefs.h"
+#include "prearm.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsPrearm)
+#pragma alloc_text (PAGE, SamsungHapticsPrearmRelax)
+#pragma alloc_text (PAGE, SamsungHapticsPrearmQuery)
+#endif
+
+#define PREARM_TIMER_RESOLUTION 10000   // 1 ms in 100 ns units
+
+NTSTATUS
+SamsungHapticsPrearm(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONG LeaseMs
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	PSAMSUNG_HAPTICS_PREARM_STATE prearm = &devContext->Prearm;
+	ULONGLONG leaseEnd;
+
+	PAGED_CODE();
+
+	if (LeaseMs == 0) {
+		LeaseMs = SAMSUNG_HAPTICS_PREARM_DEFAULT_LEASE_MS;
+	}
+
+	if (LeaseMs > SAMSUNG_HAPTICS_PREARM_MAX_LEASE_MS) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	if (devContext->Stopped) {
+		WdfWaitLockRelease(devContext->OutputLock);
+		return STATUS_DEVICE_NOT_READY;
+	}
+
+	if (prearm->CodeSectionHandle == NULL) {
+		prearm->CodeSectionHandle = MmLockPagableCodeSection((PVOID)SamsungHapticsSetState);
+	}
+
+	if (!prearm->ResolutionRaised) {
+		ExSetTimerResolution(PREARM_TIMER_RESOLUTION, TRUE);
+		prearm->ResolutionRaised = TRUE;
+	}
+
+	if (devContext->GpioWriteRequest == NULL) {
+		WDF_OBJECT_ATTRIBUTES attributes;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = devContext->Device;
+
+		status = WdfRequestCreate(&attributes, devContext->GpioIoTarget, &devContext->GpioWriteRequest);
+		if (!NT_SUCCESS(status)) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_HAPTICS, "WdfRequestCreate failed - %!STATUS!", status);
+			devContext->GpioWriteRequest = NULL;
+		}
+
+		SamsungHapticsOutputSelect(devContext);
+	}
+
+	if (WdfIoTargetGetState(devContext->GpioIoTarget) != WdfIoTargetStarted) {
+		status = WdfIoTargetStart(devContext->GpioIoTarget);
+		if (!NT_SUCCESS(status)) {
+			Trace(TRACE_LEVEL_ERROR, TRACE_HAPTICS, "WdfIoTargetStart failed - %!STATUS!", status);
+		}
+	}
+
+	leaseEnd = KeQueryInterruptTime() + (ULONGLONG)LeaseMs * 10000;
+	prearm->LeaseEnd = max(prearm->LeaseEnd, leaseEnd);
+	prearm->Prearms++;
+
+	SamsungHapticsEffectReschedule(devContext);
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	return status;
+}
+
+VOID
+SamsungHapticsPrearmRelax(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	End the lease. Must be called with OutputLock held.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_PREARM_STATE prearm = &devContext->Prearm;
+
+	PAGED_CODE();
+
+	prearm->LeaseEnd = 0;
+
+	if (prearm->ResolutionRaised) {
+		ExSetTimerResolution(0, FALSE);
+		prearm->ResolutionRaised = FALSE;
+	}
+
+	if (prearm->CodeSectionHandle != NULL) {
+		MmUnlockPagableImageSection(prearm->CodeSectionHandle);
+		prearm->CodeSectionHandle = NULL;
+	}
+}
+
+VOID
+SamsungHapticsPrearmRecordLatency(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONGLONG LatencyUs
+)
+/*++
+Routine Description:
+
+	Account the latency of a cold effect. Must be called with OutputLock
+	held.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_PREARM_STATE prearm = &devContext->Prearm;
+
+	SamsungHapticsLatencyAdd(
+		(prearm->LeaseEnd != 0) ? &prearm->ColdPrearmed : &prearm->Cold,
+		LatencyUs);
+}
+
+VOID
+SamsungHapticsPrearmQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_PREARM_STATISTICS Statistics
+)
+{
+	PSAMSUNG_HAPTICS_PREARM_STATE prearm = &devContext->Prearm;
+
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	Statistics->Prearms = prearm->Prearms;
+	Statistics->Reserved = 0;
+	Statistics->Cold = prearm->Cold;
+	Statistics->ColdPrearmed = prearm->ColdPrearmed;
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
@@ -0,0 +1,67 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Prearm.h
+
+Abstract:
+
+	Output path pre-arming definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+//
+// An effect is "cold" when the motor has been idle at least this long
+//
+#define SAMSUNG_HAPTICS_PREARM_IDLE_THRESHOLD_MS 1000
+
+typedef struct _SAMSUNG_HAPTICS_PREARM_STATE
+{
+	ULONGLONG LeaseEnd;          // interrupt time the lease expires, 0 when relaxed
+	BOOLEAN   ResolutionRaised;
+	PVOID     CodeSectionHandle; // pageable output code locked for the lease
+
+	ULONG     Prearms;
+	SAMSUNG_HAPTICS_LATENCY Cold;
+	SAMSUNG_HAPTICS_LATENCY ColdPrearmed;
+} SAMSUNG_HAPTICS_PREARM_STATE, * PSAMSUNG_HAPTICS_PREARM_STATE;
+
+struct _DEVICE_CONTEXT;
+
+NTSTATUS
+SamsungHapticsPrearm(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONG LeaseMs
+);
+
+VOID
+SamsungHapticsPrearmRelax(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsPrearmRecordLatency(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONGLONG LatencyUs
+);
+
+VOID
+SamsungHapticsPrearmQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_PREARM_STATISTICS Statistics
+);
+
+EXTERN_C_END
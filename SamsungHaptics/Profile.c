@@ -0,0 +1,260 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Profile.c - Per-device tuning profiles
+
+Abstract:
+
+	Tunables are read from the device hardware key when the device starts,
+	and again on request, so a fleet can be retuned without reinstalling.
+	Each load parses the registry into a compact immutable block. The hot
+	path only dereferences devContext->Profile and never touches the
+	registry.
+
+	The block is swapped with an interlocked exchange while OutputLock is
+	held. Every reader on the output path holds that lock, so the previous
+	block can be freed as soon as the lock is released.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "profile.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsProfileLoad)
+#pragma alloc_text (PAGE, SamsungHapticsProfileRelease)
+#endif
+
+#define PROFILE_MAX_ON_TIME_MS    60000
+#define PROFILE_MAX_PULSE_MS      1000
+#define PROFILE_MAX_TIME_CONSTANT 1000
+
+const SAMSUNG_HAPTICS_PROFILE SamsungHapticsDefaultProfile =
+{
+	SamsungHapticsModulationNone,
+	SAMSUNG_HAPTICS_MODULATOR_DEFAULT_TICK_RATE,
+	SamsungHapticsTimerHighResolution,
+	0,
+	0,
+	0,
+	SAMSUNG_HAPTICS_MOTOR_DEFAULT_SPIN_UP_MS,
+	SAMSUNG_HAPTICS_MOTOR_DEFAULT_SPIN_DOWN_MS,
+	{
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+		10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+		20, 21, 22, 23, 24, 25, 26, 27, 28, 29,
+		30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
+		40, 41, 42, 43, 44, 45, 46, 47, 48, 49,
+		50, 51, 52, 53, 54, 55, 56, 57, 58, 59,
+		60, 61, 62, 63, 64, 65, 66, 67, 68, 69,
+		70, 71, 72, 73, 74, 75, 76, 77, 78, 79,
+		80, 81, 82, 83, 84, 85, 86, 87, 88, 89,
+		90, 91, 92, 93, 94, 95, 96, 97, 98, 99,
+		100
+	}
+};
+
+static
+VOID
+SamsungHapticsProfileQueryULong(
+	_In_ WDFKEY Key,
+	_In_ PCWSTR Name,
+	_In_ ULONG Maximum,
+	_Inout_ PULONG Value
+)
+/*++
+Routine Description:
+
+	Read an optional DWORD tunable. Missing or out of range values leave the
+	default in place.
+
+--*/
+{
+	UNICODE_STRING valueName;
+	ULONG value;
+
+	RtlInitUnicodeString(&valueName, Name);
+
+	if (!NT_SUCCESS(WdfRegistryQueryULong(Key, &valueName, &value))) {
+		return;
+	}
+
+	if (value > Maximum) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "%ws = %u out of range, ignored", Name, value);
+		return;
+	}
+
+	*Value = value;
+}
+
+static
+VOID
+SamsungHapticsProfileQueryCurve(
+	_In_ WDFKEY Key,
+	_Inout_ PSAMSUNG_HAPTICS_PROFILE Profile
+)
+/*++
+Routine Description:
+
+	Read the intensity curve: a REG_BINARY of 2 to 101 output intensities
+	for requested intensities evenly spaced over 0..100. The points are
+	expanded once into the full lookup table.
+
+--*/
+{
+	UCHAR points[SAMSUNG_HAPTICS_MAX_INTENSITY + 1];
+	ULONG length = 0;
+	ULONG type = 0;
+	ULONG i;
+	DECLARE_CONST_UNICODE_STRING(valueName, L"IntensityCurve");
+
+	if (!NT_SUCCESS(WdfRegistryQueryValue(Key, &valueName, sizeof(points), points, &length, &type))) {
+		return;
+	}
+
+	if (type != REG_BINARY || length < 2) {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "IntensityCurve malformed, ignored");
+		return;
+	}
+
+	for (i = 0; i < length; i++) {
+		if (points[i] > SAMSUNG_HAPTICS_MAX_INTENSITY) {
+			Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "IntensityCurve point %u out of range, ignored", i);
+			return;
+		}
+	}
+
+	for (i = 0; i <= SAMSUNG_HAPTICS_MAX_INTENSITY; i++) {
+		ULONG position = i * (length - 1);
+		ULONG segment = position / SAMSUNG_HAPTICS_MAX_INTENSITY;
+		ULONG fraction = position % SAMSUNG_HAPTICS_MAX_INTENSITY;
+		LONG from = points[segment];
+		LONG to = (segment + 1 < length) ? points[segment + 1] : from;
+
+		Profile->IntensityCurve[i] = (UCHAR)(from + ((to - from) * (LONG)fraction) / SAMSUNG_HAPTICS_MAX_INTENSITY);
+	}
+}
+
+NTSTATUS
+SamsungHapticsProfileLoad(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Build a profile from the device hardware key, publish it and apply the
+	parts that live outside the output path (modulator carrier, timer
+	backend, motor model).
+
+--*/
+{
+	NTSTATUS status;
+	WDFKEY key;
+	PSAMSUNG_HAPTICS_PROFILE profile;
+	PCSAMSUNG_HAPTICS_PROFILE previous;
+	SAMSUNG_HAPTICS_PROFILE loaded;
+	SAMSUNG_HAPTICS_MODULATOR_CONFIG modulatorConfig;
+
+	PAGED_CODE();
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_REGISTRY, "%!FUNC! Entry");
+
+	profile = (PSAMSUNG_HAPTICS_PROFILE)ExAllocatePool2(
+		POOL_FLAG_NON_PAGED,
+		sizeof(SAMSUNG_HAPTICS_PROFILE),
+		HAPTICS_POOL_TAG);
+	if (profile == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	*profile = SamsungHapticsDefaultProfile;
+
+	status = WdfDeviceOpenRegistryKey(
+		devContext->Device,
+		PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&key);
+	if (NT_SUCCESS(status)) {
+		SamsungHapticsProfileQueryULong(key, L"Modulation", SamsungHapticsModulationMaximum - 1, &profile->Modulation);
+		SamsungHapticsProfileQueryULong(key, L"CarrierRate", SAMSUNG_HAPTICS_MODULATOR_MAX_TICK_RATE, &profile->CarrierRate);
+		SamsungHapticsProfileQueryULong(key, L"TimerBackend", SamsungHapticsTimerMaximum - 1, &profile->TimerBackend);
+		SamsungHapticsProfileQueryULong(key, L"MaxOnTimeMs", PROFILE_MAX_ON_TIME_MS, &profile->MaxOnTimeMs);
+		SamsungHapticsProfileQueryULong(key, L"MinimumPulseMs", PROFILE_MAX_PULSE_MS, &profile->MinimumPulseMs);
+		SamsungHapticsProfileQueryULong(key, L"KickMs", PROFILE_MAX_PULSE_MS, &profile->KickMs);
+		SamsungHapticsProfileQueryULong(key, L"SpinUpMs", PROFILE_MAX_TIME_CONSTANT, &profile->SpinUpMs);
+		SamsungHapticsProfileQueryULong(key, L"SpinDownMs", PROFILE_MAX_TIME_CONSTANT, &profile->SpinDownMs);
+		SamsungHapticsProfileQueryCurve(key, profile);
+		WdfRegistryClose(key);
+	}
+	else {
+		Trace(TRACE_LEVEL_WARNING, TRACE_REGISTRY, "WdfDeviceOpenRegistryKey failed - %!STATUS!, using defaults", status);
+	}
+
+	if (profile->CarrierRate < SAMSUNG_HAPTICS_MODULATOR_MIN_TICK_RATE) {
+		profile->CarrierRate = SAMSUNG_HAPTICS_MODULATOR_MIN_TICK_RATE;
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+	previous = (PCSAMSUNG_HAPTICS_PROFILE)InterlockedExchangePointer(
+		(PVOID volatile*)&devContext->Profile,
+		profile);
+	SamsungHapticsScheduleCacheFlush(&devContext->ScheduleCache);
+	devContext->Motor.SpinUpMs = profile->SpinUpMs;
+	devContext->Motor.SpinDownMs = profile->SpinDownMs;
+	SamsungHapticsTimerSetBackend(&devContext->Modulator.Timer, (SAMSUNG_HAPTICS_TIMER_BACKEND)profile->TimerBackend);
+	SamsungHapticsTimerSetBackend(&devContext->Effect.Timer, (SAMSUNG_HAPTICS_TIMER_BACKEND)profile->TimerBackend);
+
+	// Once the lock is dropped a concurrent reload may replace and free
+	// the profile, so keep what is still needed below.
+	loaded = *profile;
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	if (previous != NULL && previous != &SamsungHapticsDefaultProfile) {
+		ExFreePoolWithTag((PVOID)previous, HAPTICS_POOL_TAG);
+	}
+
+	modulatorConfig.DeviceIndex = devContext->RegistryIndex;
+	modulatorConfig.Modulation = loaded.Modulation;
+	modulatorConfig.TickRate = loaded.CarrierRate;
+	status = SamsungHapticsModulatorConfigure(devContext, &modulatorConfig);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_REGISTRY,
+		"Profile loaded: modulation %u at %u/s, timer %u, max on %u ms, min pulse %u ms, kick %u ms",
+		loaded.Modulation,
+		loaded.CarrierRate,
+		loaded.TimerBackend,
+		loaded.MaxOnTimeMs,
+		loaded.MinimumPulseMs,
+		loaded.KickMs);
+
+	return status;
+}
+
+VOID
+SamsungHapticsProfileRelease(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+{
+	PCSAMSUNG_HAPTICS_PROFILE previous;
+
+	PAGED_CODE();
+
+	previous = (PCSAMSUNG_HAPTICS_PROFILE)InterlockedExchangePointer(
+		(PVOID volatile*)&devContext->Profile,
+		(PVOID)&SamsungHapticsDefaultProfile);
+
+	if (previous != NULL && previous != &SamsungHapticsDefaultProfile) {
+		ExFreePoolWithTag((PVOID)previous, HAPTICS_POOL_TAG);
+	}
+}
@@ -0,0 +1,82 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Profile.h
+
+Abstract:
+
+	Per-device tuning profile definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+//
+// Tunables parsed once from the device hardware key. A profile block is
+// never modified after it is published; a reload builds a new block and
+// swaps the pointer.
+//
+typedef struct _SAMSUNG_HAPTICS_PROFILE
+{
+	ULONG Modulation;        // SAMSUNG_HAPTICS_MODULATION
+	ULONG CarrierRate;       // modulator ticks per second
+	ULONG TimerBackend;      // SAMSUNG_HAPTICS_TIMER_BACKEND for timed output
+	ULONG MaxOnTimeMs;       // longest continuous effect, 0 = unlimited
+	ULONG MinimumPulseMs;    // shortest effect actually played, 0 = none
+	ULONG KickMs;            // full-drive kick before a modulated effect
+	ULONG SpinUpMs;          // motor model time constants
+	ULONG SpinDownMs;
+
+	//
+	// Output intensity for each requested intensity
+	//
+	UCHAR IntensityCurve[SAMSUNG_HAPTICS_MAX_INTENSITY + 1];
+} SAMSUNG_HAPTICS_PROFILE, * PSAMSUNG_HAPTICS_PROFILE;
+
+typedef const SAMSUNG_HAPTICS_PROFILE* PCSAMSUNG_HAPTICS_PROFILE;
+
+extern const SAMSUNG_HAPTICS_PROFILE SamsungHapticsDefaultProfile;
+
+struct _DEVICE_CONTEXT;
+
+NTSTATUS
+SamsungHapticsProfileLoad(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsProfileRelease(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+FORCEINLINE
+ULONG
+SamsungHapticsProfileMapIntensity(
+	_In_ PCSAMSUNG_HAPTICS_PROFILE Profile,
+	_In_ ULONG Intensity
+)
+{
+	//
+	// Zero keeps its historical meaning of "not specified": full drive.
+	//
+	if (Intensity == 0 || Intensity >= SAMSUNG_HAPTICS_MAX_INTENSITY)
+	{
+		return SAMSUNG_HAPTICS_MAX_INTENSITY;
+	}
+
+	return Profile->IntensityCurve[Intensity];
+}
+
+EXTERN_C_END
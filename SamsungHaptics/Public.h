@@ -0,0 +1,620 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Public.h
+
+Abstract:
+
+	Definitions shared with user-mode clients of the SamsungHaptics control
+	device. HwnClx requests keep going through the HwN interface; this
+	interface only carries the features HwN has no vocabulary for.
+
+	Every request buffer starts with the registry index of the target
+	SECHWN instance.
+
+Environment:
+
+	User mode and kernel mode
+
+--*/
+
+#pragma once
+
+#define SAMSUNG_HAPTICS_CONTROL_DEVICE_NAME L"\\Device\\SamsungHaptics"
+#define SAMSUNG_HAPTICS_CONTROL_SYMBOLIC_NAME L"\\DosDevices\\SamsungHaptics"
+#define SAMSUNG_HAPTICS_CONTROL_USER_PATH L"\\\\.\\SamsungHaptics"
+
+#define SAMSUNG_HAPTICS_IOCTL(Function, Access) \
+	CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800 + (Function), METHOD_BUFFERED, (Access))
+#define SAMSUNG_HAPTICS_IOCTL_OUT_DIRECT(Function, Access) \
+	CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800 + (Function), METHOD_OUT_DIRECT, (Access))
+
+//
+// Audio-to-haptics input
+//
+#define IOCTL_SAMSUNG_HAPTICS_AUDIO_CONFIGURE SAMSUNG_HAPTICS_IOCTL(0, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_AUDIO_SUBMIT    SAMSUNG_HAPTICS_IOCTL(1, FILE_WRITE_ACCESS)
+
+#define SAMSUNG_HAPTICS_AUDIO_MAX_CHANNELS      8
+#define SAMSUNG_HAPTICS_AUDIO_MAX_BLOCK_SAMPLES 8192
+
+typedef struct _SAMSUNG_HAPTICS_AUDIO_CONFIG
+{
+	ULONG DeviceIndex;
+	ULONG SampleRate;        // Hz
+	ULONG Channels;          // interleaved 16-bit PCM channels
+	ULONG UpdateRate;        // motor updates per second
+	ULONG AttackMs;          // envelope rise time constant
+	ULONG ReleaseMs;         // envelope fall time constant
+	ULONG Gain;              // Q8, 256 = unity
+	ULONG ThresholdPercent;  // intensities below this turn the motor off
+} SAMSUNG_HAPTICS_AUDIO_CONFIG, * PSAMSUNG_HAPTICS_AUDIO_CONFIG;
+
+typedef struct _SAMSUNG_HAPTICS_AUDIO_BLOCK
+{
+	ULONG DeviceIndex;
+	ULONG SampleCount;       // total samples, all channels
+	SHORT Samples[1];
+} SAMSUNG_HAPTICS_AUDIO_BLOCK, * PSAMSUNG_HAPTICS_AUDIO_BLOCK;
+
+#define SAMSUNG_HAPTICS_AUDIO_BLOCK_HEADER_SIZE FIELD_OFFSET(SAMSUNG_HAPTICS_AUDIO_BLOCK, Samples)
+
+typedef struct _SAMSUNG_HAPTICS_AUDIO_RESULT
+{
+	ULONG UpdatesProduced;   // motor updates extracted from the block
+	ULONG LastIntensity;     // intensity sent to the motor, in percent
+} SAMSUNG_HAPTICS_AUDIO_RESULT, * PSAMSUNG_HAPTICS_AUDIO_RESULT;
+
+//
+// Intensity modulation
+//
+#define IOCTL_SAMSUNG_HAPTICS_MODULATOR_CONFIGURE SAMSUNG_HAPTICS_IOCTL(2, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_MODULATOR_QUERY     SAMSUNG_HAPTICS_IOCTL(3, FILE_READ_ACCESS)
+
+#define SAMSUNG_HAPTICS_MAX_INTENSITY           100
+#define SAMSUNG_HAPTICS_MODULATOR_MIN_TICK_RATE 50
+#define SAMSUNG_HAPTICS_MODULATOR_MAX_TICK_RATE 4000
+
+typedef enum _SAMSUNG_HAPTICS_MODULATION
+{
+	SamsungHapticsModulationNone = 0,       // intensity ignored, plain on/off
+	SamsungHapticsModulationSigmaDelta = 1, // first-order sigma-delta on the enable pin
+	SamsungHapticsModulationMaximum
+} SAMSUNG_HAPTICS_MODULATION;
+
+typedef struct _SAMSUNG_HAPTICS_MODULATOR_CONFIG
+{
+	ULONG DeviceIndex;
+	ULONG Modulation;        // SAMSUNG_HAPTICS_MODULATION
+	ULONG TickRate;          // modulator updates per second
+} SAMSUNG_HAPTICS_MODULATOR_CONFIG, * PSAMSUNG_HAPTICS_MODULATOR_CONFIG;
+
+typedef struct _SAMSUNG_HAPTICS_MODULATOR_STATISTICS
+{
+	ULONG     Modulation;
+	ULONG     TickRate;
+	ULONGLONG Ticks;         // modulator ticks processed
+	ULONGLONG PinWrites;     // pin writes issued by the modulator
+
+	//
+	// Steady-state pin writes per second for each intensity level at the
+	// configured tick rate.
+	//
+	ULONG     TogglesPerSecond[SAMSUNG_HAPTICS_MAX_INTENSITY + 1];
+} SAMSUNG_HAPTICS_MODULATOR_STATISTICS, * PSAMSUNG_HAPTICS_MODULATOR_STATISTICS;
+
+//
+// ERM motor model
+//
+#define IOCTL_SAMSUNG_HAPTICS_MOTOR_QUERY SAMSUNG_HAPTICS_IOCTL(4, FILE_READ_ACCESS)
+
+#define SAMSUNG_HAPTICS_MOTOR_EFFECT_HISTORY 8
+
+//
+// Figures estimated by the driver's first-order ERM model for one effect.
+// Accelerations are relative to the motor's rated steady state, in
+// hundredths of a percent (10000 = rated).
+//
+typedef struct _SAMSUNG_HAPTICS_MOTOR_EFFECT
+{
+	ULONG DurationUs;        // effect start to effect end
+	ULONG RiseTimeUs;        // effect start to 90% rated speed, 0 if never reached
+	ULONG FallTimeUs;        // effect end to 10% rated speed
+	ULONG PeakAcceleration;
+	ULONG MeanAcceleration;
+	ULONG PinWrites;         // pin writes issued during the effect
+} SAMSUNG_HAPTICS_MOTOR_EFFECT, * PSAMSUNG_HAPTICS_MOTOR_EFFECT;
+
+typedef struct _SAMSUNG_HAPTICS_MOTOR_STATISTICS
+{
+	ULONG SpinUpMs;          // model time constants
+	ULONG SpinDownMs;
+	ULONG EffectCount;       // effects completed since start
+	ULONG Reserved;
+
+	//
+	// Most recent effects, newest at index (EffectCount - 1) % HISTORY
+	//
+	SAMSUNG_HAPTICS_MOTOR_EFFECT Effects[SAMSUNG_HAPTICS_MOTOR_EFFECT_HISTORY];
+} SAMSUNG_HAPTICS_MOTOR_STATISTICS, * PSAMSUNG_HAPTICS_MOTOR_STATISTICS;
+
+//
+// Pin output path
+//
+#define IOCTL_SAMSUNG_HAPTICS_OUTPUT_QUERY SAMSUNG_HAPTICS_IOCTL(5, FILE_READ_ACCESS)
+
+typedef enum _SAMSUNG_HAPTICS_OUTPUT_BACKEND
+{
+	SamsungHapticsOutputBackendIoctl = 0,    // IOCTL_GPIO_WRITE_PINS through GpioClx
+	SamsungHapticsOutputBackendRegister = 1, // direct write of the TLMM output register
+} SAMSUNG_HAPTICS_OUTPUT_BACKEND;
+
+typedef struct _SAMSUNG_HAPTICS_OUTPUT_STATISTICS
+{
+	ULONG     Backend;       // SAMSUNG_HAPTICS_OUTPUT_BACKEND
+	ULONG     Reserved;
+	ULONGLONG PinWrites;
+	ULONGLONG PinWriteTimeNs; // total time spent in pin writes
+} SAMSUNG_HAPTICS_OUTPUT_STATISTICS, * PSAMSUNG_HAPTICS_OUTPUT_STATISTICS;
+
+//
+// Tuning profile
+//
+#define IOCTL_SAMSUNG_HAPTICS_PROFILE_RELOAD SAMSUNG_HAPTICS_IOCTL(6, FILE_WRITE_ACCESS)
+
+//
+// Pre-arming the output path
+//
+#define IOCTL_SAMSUNG_HAPTICS_PREARM       SAMSUNG_HAPTICS_IOCTL(7, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_PREARM_QUERY SAMSUNG_HAPTICS_IOCTL(8, FILE_READ_ACCESS)
+
+#define SAMSUNG_HAPTICS_PREARM_DEFAULT_LEASE_MS 500
+#define SAMSUNG_HAPTICS_PREARM_MAX_LEASE_MS     5000
+
+typedef struct _SAMSUNG_HAPTICS_PREARM
+{
+	ULONG DeviceIndex;
+	ULONG LeaseMs;           // 0 selects the default lease
+} SAMSUNG_HAPTICS_PREARM, * PSAMSUNG_HAPTICS_PREARM;
+
+typedef struct _SAMSUNG_HAPTICS_LATENCY
+{
+	ULONG     Count;
+	ULONG     MaxUs;
+	ULONGLONG TotalUs;
+} SAMSUNG_HAPTICS_LATENCY, * PSAMSUNG_HAPTICS_LATENCY;
+
+typedef struct _SAMSUNG_HAPTICS_PREARM_STATISTICS
+{
+	ULONG Prearms;
+	ULONG Reserved;
+
+	//
+	// Request-to-pin latency of the first effect after the motor has been
+	// idle, without and with an active pre-arm lease
+	//
+	SAMSUNG_HAPTICS_LATENCY Cold;
+	SAMSUNG_HAPTICS_LATENCY ColdPrearmed;
+} SAMSUNG_HAPTICS_PREARM_STATISTICS, * PSAMSUNG_HAPTICS_PREARM_STATISTICS;
+
+//
+// Timed output
+//
+#define IOCTL_SAMSUNG_HAPTICS_TIMER_QUERY SAMSUNG_HAPTICS_IOCTL(9, FILE_READ_ACCESS)
+
+typedef enum _SAMSUNG_HAPTICS_TIMER_BACKEND
+{
+	SamsungHapticsTimerHighResolution = 0, // EX_TIMER_HIGH_RESOLUTION
+	SamsungHapticsTimerCoalescable = 1,    // coalescable KTIMER, 1 ms granularity
+	SamsungHapticsTimerSpin = 2,           // real-time thread spinning on the performance counter
+	SamsungHapticsTimerMaximum
+} SAMSUNG_HAPTICS_TIMER_BACKEND;
+
+//
+// Expiration error histogram: |error| up to 10, 25, 50, 100, 250, 500 and
+// 1000 us, and above
+//
+#define SAMSUNG_HAPTICS_TIMER_HISTOGRAM_BUCKETS 8
+
+typedef struct _SAMSUNG_HAPTICS_TIMER_STATISTICS
+{
+	ULONG     Backend;       // SAMSUNG_HAPTICS_TIMER_BACKEND
+	ULONG     Reserved;
+	ULONGLONG Expirations;
+	ULONGLONG Early;         // expirations before their deadline
+	ULONGLONG Missed;        // periods skipped because the callback overran
+	ULONGLONG MaxErrorUs;
+	ULONGLONG TotalErrorUs;
+	ULONGLONG Histogram[SAMSUNG_HAPTICS_TIMER_HISTOGRAM_BUCKETS];
+} SAMSUNG_HAPTICS_TIMER_STATISTICS, * PSAMSUNG_HAPTICS_TIMER_STATISTICS;
+
+typedef struct _SAMSUNG_HAPTICS_TIMER_QUERY_RESULT
+{
+	SAMSUNG_HAPTICS_TIMER_STATISTICS Modulator;
+	SAMSUNG_HAPTICS_TIMER_STATISTICS Effect;
+} SAMSUNG_HAPTICS_TIMER_QUERY_RESULT, * PSAMSUNG_HAPTICS_TIMER_QUERY_RESULT;
+
+//
+// Effect mixing
+//
+#define IOCTL_SAMSUNG_HAPTICS_PLAY        SAMSUNG_HAPTICS_IOCTL(10, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_MIXER_QUERY SAMSUNG_HAPTICS_IOCTL(11, FILE_READ_ACCESS)
+
+#define SAMSUNG_HAPTICS_MIXER_VOICES     4
+#define SAMSUNG_HAPTICS_MAX_PLAY_MS      10000
+
+typedef enum _SAMSUNG_HAPTICS_VOICE_SOURCE
+{
+	SamsungHapticsVoiceFree = 0,
+	SamsungHapticsVoiceHwn = 1,    // HwN requests, held until HWN_OFF
+	SamsungHapticsVoiceAudio = 2,  // audio envelope
+	SamsungHapticsVoiceTimed = 3,  // IOCTL_SAMSUNG_HAPTICS_PLAY, retired at its end time
+	SamsungHapticsVoiceStream = 4, // shared-memory intensity stream
+} SAMSUNG_HAPTICS_VOICE_SOURCE;
+
+//
+// Only the voices of the highest active priority are mixed. HwN requests
+// play at normal priority, the audio envelope at low priority.
+//
+typedef enum _SAMSUNG_HAPTICS_PRIORITY
+{
+	SamsungHapticsPriorityLow = 0,
+	SamsungHapticsPriorityNormal = 1,
+	SamsungHapticsPriorityHigh = 2,
+	SamsungHapticsPriorityCritical = 3,  // alarms, incoming calls
+	SamsungHapticsPriorityMaximum
+} SAMSUNG_HAPTICS_PRIORITY;
+
+//
+// What happens to a voice while a higher priority plays
+//
+typedef enum _SAMSUNG_HAPTICS_PREEMPT_POLICY
+{
+	SamsungHapticsPreemptResume = 0, // silenced, plays again if still running
+	SamsungHapticsPreemptDrop = 1,   // retired
+	SamsungHapticsPreemptMaximum
+} SAMSUNG_HAPTICS_PREEMPT_POLICY;
+
+typedef struct _SAMSUNG_HAPTICS_PLAY
+{
+	ULONG DeviceIndex;
+	ULONG Intensity;         // 0 or >= SAMSUNG_HAPTICS_MAX_INTENSITY for full drive
+	ULONG DurationMs;        // 1 to SAMSUNG_HAPTICS_MAX_PLAY_MS
+	ULONG Priority;          // SAMSUNG_HAPTICS_PRIORITY
+	ULONG PreemptPolicy;     // SAMSUNG_HAPTICS_PREEMPT_POLICY
+} SAMSUNG_HAPTICS_PLAY, * PSAMSUNG_HAPTICS_PLAY;
+
+typedef struct _SAMSUNG_HAPTICS_VOICE_INFO
+{
+	ULONG Source;            // SAMSUNG_HAPTICS_VOICE_SOURCE
+	ULONG Intensity;
+	ULONG RemainingMs;       // 0 for voices without an end time
+	ULONG Priority;
+	ULONG Preempted;         // silenced by a higher priority voice
+} SAMSUNG_HAPTICS_VOICE_INFO, * PSAMSUNG_HAPTICS_VOICE_INFO;
+
+typedef struct _SAMSUNG_HAPTICS_MIXER_STATISTICS
+{
+	ULONG     Output;        // current mixed intensity, 0 when idle
+	ULONG     Reserved;
+	ULONGLONG Mixes;
+	ULONGLONG Retired;       // timed voices that reached their end
+	ULONGLONG Stolen;        // timed voices replaced while every slot was busy
+	ULONGLONG Preemptions;   // voices silenced by a higher priority
+	ULONGLONG Dropped;       // voices retired by SamsungHapticsPreemptDrop
+
+	//
+	// Request-to-pin latency of critical priority requests, and of those
+	// among them that ran while a slower control request was in flight
+	//
+	SAMSUNG_HAPTICS_LATENCY CriticalLatency;
+	SAMSUNG_HAPTICS_LATENCY CriticalContended;
+
+	SAMSUNG_HAPTICS_VOICE_INFO Voices[SAMSUNG_HAPTICS_MIXER_VOICES];
+} SAMSUNG_HAPTICS_MIXER_STATISTICS, * PSAMSUNG_HAPTICS_MIXER_STATISTICS;
+
+//
+// Power transitions
+//
+#define IOCTL_SAMSUNG_HAPTICS_POWER_QUERY SAMSUNG_HAPTICS_IOCTL(12, FILE_READ_ACCESS)
+
+typedef struct _SAMSUNG_HAPTICS_POWER_STATISTICS
+{
+	ULONG LastStartUs;
+	ULONG LastStopUs;
+
+	//
+	// Time spent restoring the output on D0 entry, including reading the
+	// tuning on the first one, and quiescing it on D0 exit
+	//
+	SAMSUNG_HAPTICS_LATENCY Start;
+	SAMSUNG_HAPTICS_LATENCY Stop;
+} SAMSUNG_HAPTICS_POWER_STATISTICS, * PSAMSUNG_HAPTICS_POWER_STATISTICS;
+
+//
+// Battery saver scaling
+//
+#define IOCTL_SAMSUNG_HAPTICS_SAVER_CONFIGURE SAMSUNG_HAPTICS_IOCTL(13, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_SAVER_QUERY     SAMSUNG_HAPTICS_IOCTL(14, FILE_READ_ACCESS)
+
+typedef enum _SAMSUNG_HAPTICS_SAVER_MODE
+{
+	SamsungHapticsSaverAuto = 0,   // follows the system battery saver
+	SamsungHapticsSaverOff = 1,
+	SamsungHapticsSaverOn = 2,
+	SamsungHapticsSaverMaximum
+} SAMSUNG_HAPTICS_SAVER_MODE;
+
+#define SAMSUNG_HAPTICS_SAVER_DEFAULT_SCALE        60
+#define SAMSUNG_HAPTICS_SAVER_DEFAULT_MAX_PULSE_MS 250
+#define SAMSUNG_HAPTICS_SAVER_MAX_PULSE_MS         10000
+
+typedef struct _SAMSUNG_HAPTICS_SAVER_CONFIG
+{
+	ULONG DeviceIndex;       // ignored, the mode is driver-wide
+	ULONG Mode;              // SAMSUNG_HAPTICS_SAVER_MODE
+	ULONG ScalePercent;      // 1 to 100, applied to the output intensity
+	ULONG MaxPulseMs;        // 0 = no limit beyond the profile's
+} SAMSUNG_HAPTICS_SAVER_CONFIG, * PSAMSUNG_HAPTICS_SAVER_CONFIG;
+
+typedef struct _SAMSUNG_HAPTICS_SAVER_STATISTICS
+{
+	SAMSUNG_HAPTICS_SAVER_CONFIG Config;
+	ULONG     SystemSaver;   // system battery saver is on
+	ULONG     Active;        // scaling currently applied
+
+	//
+	// ON time saved on this device while scaling was active: the part of
+	// effects cut by the pulse limit, and the full-drive equivalent of the
+	// intensity reduction on modulated effects
+	//
+	ULONGLONG Truncations;
+	ULONGLONG TruncatedOnTimeMs;
+	ULONGLONG ScaledOnTimeMs;
+} SAMSUNG_HAPTICS_SAVER_STATISTICS, * PSAMSUNG_HAPTICS_SAVER_STATISTICS;
+
+//
+// Recording and replay of HwN request streams. Recordings hold the requests
+// of every app, so reading one requires a handle opened for writing too.
+//
+#define IOCTL_SAMSUNG_HAPTICS_RECORD_START SAMSUNG_HAPTICS_IOCTL(15, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_RECORD_STOP  SAMSUNG_HAPTICS_IOCTL(16, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_RECORD_READ  SAMSUNG_HAPTICS_IOCTL(17, FILE_READ_ACCESS | FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_REPLAY       SAMSUNG_HAPTICS_IOCTL(18, FILE_WRITE_ACCESS)
+
+#define SAMSUNG_HAPTICS_RECORDING_VERSION       1
+#define SAMSUNG_HAPTICS_RECORD_DEFAULT_RING     (64 * 1024)
+#define SAMSUNG_HAPTICS_RECORD_MAX_RING         (1024 * 1024)
+#define SAMSUNG_HAPTICS_RECORD_MAX_PAYLOAD      512
+#define SAMSUNG_HAPTICS_REPLAY_MAX_SPEED        10000   // percent
+#define SAMSUNG_HAPTICS_REPLAY_MAX_GAP_MS       1000
+#define SAMSUNG_HAPTICS_REPLAY_MAX_DURATION_MS  (60 * 1000)
+
+typedef enum _SAMSUNG_HAPTICS_RECORD_TYPE
+{
+	SamsungHapticsRecordSetState = 1,
+	SamsungHapticsRecordGetState = 2,
+} SAMSUNG_HAPTICS_RECORD_TYPE;
+
+#define SAMSUNG_HAPTICS_RECORD_FLAG_TRUNCATED 0x01
+
+//
+// One captured callback: the SetState input or GetState output buffer
+// follows the header. Records are 8-byte aligned and packed back to back.
+//
+typedef struct _SAMSUNG_HAPTICS_RECORD
+{
+	USHORT    Size;          // header and payload, rounded up to 8 bytes
+	UCHAR     Type;          // SAMSUNG_HAPTICS_RECORD_TYPE
+	UCHAR     Flags;
+	ULONG     Length;        // payload bytes
+	LONG      Status;        // what the callback returned
+	ULONG     LatencyUs;     // time spent in the callback
+	ULONGLONG Timestamp;     // interrupt time at entry, 100 ns units
+} SAMSUNG_HAPTICS_RECORD, * PSAMSUNG_HAPTICS_RECORD;
+
+//
+// Returned by IOCTL_SAMSUNG_HAPTICS_RECORD_READ, oldest record first. The
+// same layout, written to a file as is, is the input of a replay.
+//
+typedef struct _SAMSUNG_HAPTICS_RECORDING
+{
+	ULONG Version;
+	ULONG Records;
+	ULONG Overwritten;       // records lost to the ring wrapping
+	ULONG Length;            // bytes of records following this header
+} SAMSUNG_HAPTICS_RECORDING, * PSAMSUNG_HAPTICS_RECORDING;
+
+typedef struct _SAMSUNG_HAPTICS_RECORD_START
+{
+	ULONG DeviceIndex;
+	ULONG RingSize;          // 0 selects the default
+} SAMSUNG_HAPTICS_RECORD_START, * PSAMSUNG_HAPTICS_RECORD_START;
+
+typedef struct _SAMSUNG_HAPTICS_REPLAY
+{
+	ULONG DeviceIndex;
+	ULONG SpeedPercent;      // 100 = original timing, 0 = back to back
+	SAMSUNG_HAPTICS_RECORDING Recording;
+	// records follow
+} SAMSUNG_HAPTICS_REPLAY, * PSAMSUNG_HAPTICS_REPLAY;
+
+typedef struct _SAMSUNG_HAPTICS_REPLAY_RESULT
+{
+	ULONG     Records;
+	ULONG     Failures;      // callbacks that failed
+	ULONG     Mismatches;    // callbacks whose status differs from the recording
+	ULONG     Truncated;     // nonzero when the duration cap cut the replay short
+	ULONGLONG PinWrites;
+	SAMSUNG_HAPTICS_LATENCY SetState;
+	SAMSUNG_HAPTICS_LATENCY GetState;
+} SAMSUNG_HAPTICS_REPLAY_RESULT, * PSAMSUNG_HAPTICS_REPLAY_RESULT;
+
+//
+// Concurrent HwN callbacks
+//
+#define IOCTL_SAMSUNG_HAPTICS_CONCURRENCY_QUERY SAMSUNG_HAPTICS_IOCTL(19, FILE_READ_ACCESS)
+
+typedef struct _SAMSUNG_HAPTICS_CONCURRENCY_STATISTICS
+{
+	ULONG SetStateCalls;
+	ULONG GetStateCalls;
+	ULONG Overlapped;        // callbacks that entered while another was running
+	ULONG MaxInFlight;       // most callbacks seen inside the driver at once
+	ULONG Inconsistent;      // GetState results that disagreed with the output
+	ULONG Reserved;
+} SAMSUNG_HAPTICS_CONCURRENCY_STATISTICS, * PSAMSUNG_HAPTICS_CONCURRENCY_STATISTICS;
+
+//
+// Effect library
+//
+// A REG_BINARY "EffectLibrary" value in the device hardware key holds a
+// SAMSUNG_HAPTICS_LIBRARY_HEADER followed by EffectCount effects, each a
+// SAMSUNG_HAPTICS_LIBRARY_ENTRY followed by its StepCount steps. Clients
+// play an effect by id on the control device; the HwN settings have no
+// field for it.
+//
+#define IOCTL_SAMSUNG_HAPTICS_LIBRARY_QUERY SAMSUNG_HAPTICS_IOCTL(20, FILE_READ_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_PLAY_EFFECT   SAMSUNG_HAPTICS_IOCTL(28, FILE_WRITE_ACCESS)
+
+#define SAMSUNG_HAPTICS_LIBRARY_SIGNATURE     'LEHS'
+#define SAMSUNG_HAPTICS_LIBRARY_VERSION       1
+#define SAMSUNG_HAPTICS_LIBRARY_MAX_ID        63
+#define SAMSUNG_HAPTICS_LIBRARY_MAX_STEPS     64      // per effect
+#define SAMSUNG_HAPTICS_LIBRARY_MAX_TOTAL     1024    // steps in the whole library
+#define SAMSUNG_HAPTICS_LIBRARY_MAX_EFFECT_MS 30000
+
+typedef struct _SAMSUNG_HAPTICS_LIBRARY_HEADER
+{
+	ULONG  Signature;        // SAMSUNG_HAPTICS_LIBRARY_SIGNATURE
+	USHORT Version;
+	USHORT EffectCount;
+} SAMSUNG_HAPTICS_LIBRARY_HEADER, * PSAMSUNG_HAPTICS_LIBRARY_HEADER;
+
+typedef struct _SAMSUNG_HAPTICS_LIBRARY_ENTRY
+{
+	UCHAR  Id;               // 1 to SAMSUNG_HAPTICS_LIBRARY_MAX_ID
+	UCHAR  Reserved;
+	USHORT StepCount;        // 1 to SAMSUNG_HAPTICS_LIBRARY_MAX_STEPS
+} SAMSUNG_HAPTICS_LIBRARY_ENTRY, * PSAMSUNG_HAPTICS_LIBRARY_ENTRY;
+
+typedef struct _SAMSUNG_HAPTICS_LIBRARY_STEP
+{
+	UCHAR  Intensity;        // 0 for a pause, else 1 to SAMSUNG_HAPTICS_MAX_INTENSITY
+	UCHAR  Reserved;
+	USHORT DurationMs;       // at least 1
+} SAMSUNG_HAPTICS_LIBRARY_STEP, * PSAMSUNG_HAPTICS_LIBRARY_STEP;
+
+typedef struct _SAMSUNG_HAPTICS_PLAY_EFFECT
+{
+	ULONG DeviceIndex;
+	ULONG EffectId;          // 1 to SAMSUNG_HAPTICS_LIBRARY_MAX_ID
+	ULONG Intensity;         // scales the effect, 0 plays it as authored
+	ULONG Priority;          // SAMSUNG_HAPTICS_PRIORITY
+	ULONG PreemptPolicy;     // SAMSUNG_HAPTICS_PREEMPT_POLICY
+} SAMSUNG_HAPTICS_PLAY_EFFECT, * PSAMSUNG_HAPTICS_PLAY_EFFECT;
+
+typedef struct _SAMSUNG_HAPTICS_LIBRARY_STATISTICS
+{
+	LONG  LoadStatus;        // NTSTATUS of the last load
+	ULONG Effects;
+	ULONG Steps;
+	ULONG FootprintBytes;    // nonpaged memory held by the loaded table
+	ULONG Plays;
+	ULONG UnknownIds;        // requests naming an effect the library lacks
+} SAMSUNG_HAPTICS_LIBRARY_STATISTICS, * PSAMSUNG_HAPTICS_LIBRARY_STATISTICS;
+
+//
+// Pin write calibration
+//
+#define IOCTL_SAMSUNG_HAPTICS_CALIBRATE         SAMSUNG_HAPTICS_IOCTL(21, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_CALIBRATION_QUERY SAMSUNG_HAPTICS_IOCTL(22, FILE_READ_ACCESS)
+
+#define SAMSUNG_HAPTICS_CALIBRATION_SAMPLES 64
+
+typedef struct _SAMSUNG_HAPTICS_CALIBRATION
+{
+	LONG      Status;        // NTSTATUS of the last run
+	ULONG     Runs;
+	ULONG     Samples;       // pin writes measured by the last successful run
+	ULONG     MinNs;
+	ULONG     MedianNs;
+	ULONG     P99Ns;
+	ULONG     MaxNs;
+	ULONG     LeadNs;        // how early timed edges are issued
+	ULONG     CarrierLimit;  // highest modulator tick rate the pin path sustains
+	ULONG     GenericMedianNs; // same burst through the generic writer, 0 if not measured
+	ULONGLONG Timestamp;     // interrupt time of the last successful run
+} SAMSUNG_HAPTICS_CALIBRATION, * PSAMSUNG_HAPTICS_CALIBRATION;
+
+//
+// Compiled library effect schedules
+//
+#define IOCTL_SAMSUNG_HAPTICS_SCHEDULE_QUERY SAMSUNG_HAPTICS_IOCTL(23, FILE_READ_ACCESS)
+
+#define SAMSUNG_HAPTICS_SCHEDULE_CACHE_ENTRIES 16
+
+typedef struct _SAMSUNG_HAPTICS_SCHEDULE_STATISTICS
+{
+	ULONG Entries;           // valid compiled schedules
+	ULONG Reserved;
+	ULONGLONG Hits;
+	ULONGLONG Misses;
+	ULONGLONG Evictions;     // valid schedules replaced by another
+	ULONGLONG Flushes;       // profile or library reloads
+} SAMSUNG_HAPTICS_SCHEDULE_STATISTICS, * PSAMSUNG_HAPTICS_SCHEDULE_STATISTICS;
+
+//
+// Shared-memory intensity stream
+//
+// The client allocates a SAMSUNG_HAPTICS_STREAM_RING and sends it as the
+// output buffer of IOCTL_SAMSUNG_HAPTICS_STREAM_ATTACH, which stays pending
+// while the stream is attached. The client appends samples and advances
+// Producer; the driver consumes them from its output timer and advances
+// Consumer. Indices count samples and wrap; a sample lives at
+// Samples[index % Capacity]. Producer must be 0 when attaching.
+//
+#define IOCTL_SAMSUNG_HAPTICS_STREAM_ATTACH SAMSUNG_HAPTICS_IOCTL_OUT_DIRECT(25, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_STREAM_DETACH SAMSUNG_HAPTICS_IOCTL(26, FILE_WRITE_ACCESS)
+#define IOCTL_SAMSUNG_HAPTICS_STREAM_QUERY  SAMSUNG_HAPTICS_IOCTL(27, FILE_READ_ACCESS)
+
+#define SAMSUNG_HAPTICS_STREAM_MIN_SAMPLES 16
+#define SAMSUNG_HAPTICS_STREAM_MAX_SAMPLES 4096
+#define SAMSUNG_HAPTICS_STREAM_ALIGNMENT   64
+
+typedef struct _SAMSUNG_HAPTICS_STREAM_SAMPLE
+{
+	ULONGLONG Timestamp;     // interrupt time to apply the sample at, 0 for at once
+	ULONG     Intensity;     // 0 (off) to SAMSUNG_HAPTICS_MAX_INTENSITY
+	ULONG     Reserved;
+} SAMSUNG_HAPTICS_STREAM_SAMPLE, * PSAMSUNG_HAPTICS_STREAM_SAMPLE;
+
+typedef struct _SAMSUNG_HAPTICS_STREAM_RING
+{
+	volatile ULONG Producer; // written by the client
+	ULONG     Reserved0[15];
+	volatile ULONG Consumer; // written by the driver
+	ULONG     Capacity;      // written by the driver when attaching, a power of 2
+	ULONG     Reserved1[14];
+	SAMSUNG_HAPTICS_STREAM_SAMPLE Samples[ANYSIZE_ARRAY];
+} SAMSUNG_HAPTICS_STREAM_RING, * PSAMSUNG_HAPTICS_STREAM_RING;
+
+typedef struct _SAMSUNG_HAPTICS_STREAM_STATISTICS
+{
+	ULONG     Attached;
+	ULONG     Capacity;
+	ULONG     Intensity;     // intensity of the last applied sample
+	ULONG     Reserved;
+	ULONGLONG Attaches;
+	ULONGLONG Consumed;
+	ULONGLONG Superseded;    // due samples replaced by a later one in the same poll
+	ULONGLONG Underruns;     // polls that found the ring empty while driving
+	ULONGLONG Overruns;      // invalid producer indices, ring resynchronized
+	ULONGLONG Timeouts;      // stream voices stopped for lack of samples
+	ULONGLONG Polls;
+	ULONGLONG ConsumeNs;     // time spent consuming, over Consumed for a per-sample cost
+} SAMSUNG_HAPTICS_STREAM_STATISTICS, * PSAMSUNG_HAPTICS_STREAM_STATISTICS;
@@ -0,0 +1,478 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Recorder.c - Recording and replay of HwN request streams
+
+Abstract:
+
+	Timing problems seen in the field depend on the exact SetState and
+	GetState sequence apps produce. While recording is on, every callback
+	buffer is captured with its entry time, status and latency into a ring
+	allocated up front, overwriting the oldest records when full. The ring
+	is read back from the control device in a compact binary format that
+	can be stored in a file.
+
+	A recording can be fed back into the same device at its original pace,
+	accelerated, or back to back. Replayed callbacks go through the real
+	HwN entry points, so the result reports their latency and the pin
+	writes they caused. Idle gaps and the replay as a whole are capped so
+	a replay stays short, and it stops between records as soon as its
+	request is cancelled or the device goes away.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "recorder.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsRecorderUninitialize)
+#pragma alloc_text (PAGE, SamsungHapticsRecorderStop)
+#pragma alloc_text (PAGE, SamsungHapticsRecorderReplay)
+#endif
+
+#define RECORD_SIZE(Length) ((ULONG)ALIGN_UP_BY(sizeof(SAMSUNG_HAPTICS_RECORD) + (Length), 8))
+
+#define REPLAY_POLL (50 * 10000)   // 50 ms in interrupt time
+
+static
+VOID
+SamsungHapticsRecorderRingWrite(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_In_ ULONG Offset,
+	_In_reads_bytes_(Length) const VOID* Data,
+	_In_ ULONG Length
+)
+{
+	ULONG first = min(Length, Recorder->RingSize - Offset);
+
+	RtlCopyMemory(Recorder->Ring + Offset, Data, first);
+	RtlCopyMemory(Recorder->Ring, (const UCHAR*)Data + first, Length - first);
+}
+
+static
+VOID
+SamsungHapticsRecorderRingRead(
+	_In_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_In_ ULONG Offset,
+	_Out_writes_bytes_(Length) PVOID Data,
+	_In_ ULONG Length
+)
+{
+	ULONG first = min(Length, Recorder->RingSize - Offset);
+
+	RtlCopyMemory(Data, Recorder->Ring + Offset, first);
+	RtlCopyMemory((PUCHAR)Data + first, Recorder->Ring, Length - first);
+}
+
+VOID
+SamsungHapticsRecorderInitialize(
+	_Out_ PSAMSUNG_HAPTICS_RECORDER Recorder
+)
+{
+	RtlZeroMemory(Recorder, sizeof(*Recorder));
+	KeInitializeSpinLock(&Recorder->Lock);
+	KeInitializeEvent(&Recorder->Abort, NotificationEvent, FALSE);
+}
+
+VOID
+SamsungHapticsRecorderAbort(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder
+)
+/*++
+Routine Description:
+
+	Make a replay in progress, and any later one, stop at the next record.
+	Called once the device can no longer be looked up.
+
+--*/
+{
+	KeSetEvent(&Recorder->Abort, IO_NO_INCREMENT, FALSE);
+}
+
+static
+NTSTATUS
+SamsungHapticsRecorderReplayWait(
+	_In_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_In_ WDFREQUEST Request,
+	_In_ ULONGLONG Delay
+)
+/*++
+Routine Description:
+
+	Wait out the gap before the next record in slices, giving up as soon
+	as the request is cancelled or the device goes away. A zero delay only
+	checks both.
+
+--*/
+{
+	LARGE_INTEGER timeout;
+	ULONGLONG slice;
+
+	do {
+		if (WdfRequestIsCanceled(Request)) {
+			return STATUS_CANCELLED;
+		}
+
+		slice = min(Delay, REPLAY_POLL);
+		timeout.QuadPart = -(LONGLONG)slice;
+
+		if (KeWaitForSingleObject(&Recorder->Abort, Executive, KernelMode, FALSE, &timeout) == STATUS_SUCCESS) {
+			return STATUS_NO_SUCH_DEVICE;
+		}
+
+		Delay -= slice;
+	} while (Delay != 0);
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+SamsungHapticsRecorderUninitialize(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder
+)
+{
+	PAGED_CODE();
+
+	InterlockedExchange(&Recorder->Recording, FALSE);
+
+	if (Recorder->Ring != NULL) {
+		ExFreePoolWithTag(Recorder->Ring, HAPTICS_POOL_TAG);
+		Recorder->Ring = NULL;
+	}
+}
+
+VOID
+SamsungHapticsRecorderCapture(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_In_ SAMSUNG_HAPTICS_RECORD_TYPE Type,
+	_In_ NTSTATUS Status,
+	_In_ ULONGLONG Timestamp,
+	_In_ LARGE_INTEGER Start,
+	_In_reads_bytes_(Length) PVOID Payload,
+	_In_ ULONG Length
+)
+/*++
+Routine Description:
+
+	Append a record for a callback that just completed. The payload is
+	staged on the stack first since HwN buffers may be pageable.
+
+--*/
+{
+	SAMSUNG_HAPTICS_RECORD record;
+	UCHAR payload[SAMSUNG_HAPTICS_RECORD_MAX_PAYLOAD];
+	KIRQL irql;
+	ULONG tail;
+
+	if (!ReadNoFence(&Recorder->Recording) || ReadNoFence(&Recorder->Replaying)) {
+		return;
+	}
+
+	record.Type = (UCHAR)Type;
+	record.Flags = 0;
+	record.Length = min(Length, SAMSUNG_HAPTICS_RECORD_MAX_PAYLOAD);
+	record.Size = (USHORT)RECORD_SIZE(record.Length);
+	record.Status = Status;
+	record.LatencyUs = (ULONG)min(SamsungHapticsElapsedUs(Start), MAXULONG);
+	record.Timestamp = Timestamp;
+
+	if (record.Length < Length) {
+		record.Flags |= SAMSUNG_HAPTICS_RECORD_FLAG_TRUNCATED;
+	}
+
+	if (Payload != NULL) {
+		RtlCopyMemory(payload, Payload, record.Length);
+	}
+	else {
+		record.Length = 0;
+	}
+
+	KeAcquireSpinLock(&Recorder->Lock, &irql);
+
+	if (Recorder->Ring == NULL || !ReadNoFence(&Recorder->Recording) || record.Size > Recorder->RingSize) {
+		goto exit;
+	}
+
+	while (Recorder->RingSize - Recorder->Used < record.Size) {
+		USHORT oldest;
+
+		SamsungHapticsRecorderRingRead(Recorder, Recorder->Head, &oldest, sizeof(oldest));
+		Recorder->Head = (Recorder->Head + oldest) % Recorder->RingSize;
+		Recorder->Used -= oldest;
+		Recorder->Records--;
+		Recorder->Overwritten++;
+	}
+
+	tail = (Recorder->Head + Recorder->Used) % Recorder->RingSize;
+	SamsungHapticsRecorderRingWrite(Recorder, tail, &record, sizeof(record));
+	SamsungHapticsRecorderRingWrite(
+		Recorder,
+		(tail + sizeof(record)) % Recorder->RingSize,
+		payload,
+		record.Length);
+
+	Recorder->Used += record.Size;
+	Recorder->Records++;
+
+exit:
+	KeReleaseSpinLock(&Recorder->Lock, irql);
+}
+
+NTSTATUS
+SamsungHapticsRecorderStart(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_In_ ULONG RingSize
+)
+/*++
+Routine Description:
+
+	Start a new recording into a freshly allocated ring, discarding the
+	previous one.
+
+--*/
+{
+	PUCHAR ring;
+	PUCHAR previous;
+	KIRQL irql;
+
+	if (RingSize == 0) {
+		RingSize = SAMSUNG_HAPTICS_RECORD_DEFAULT_RING;
+	}
+
+	if (RingSize < RECORD_SIZE(SAMSUNG_HAPTICS_RECORD_MAX_PAYLOAD) ||
+		RingSize > SAMSUNG_HAPTICS_RECORD_MAX_RING ||
+		(RingSize % 8) != 0) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	ring = (PUCHAR)ExAllocatePool2(POOL_FLAG_NON_PAGED, RingSize, HAPTICS_POOL_TAG);
+	if (ring == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	KeAcquireSpinLock(&Recorder->Lock, &irql);
+
+	previous = Recorder->Ring;
+	Recorder->Ring = ring;
+	Recorder->RingSize = RingSize;
+	Recorder->Head = 0;
+	Recorder->Used = 0;
+	Recorder->Records = 0;
+	Recorder->Overwritten = 0;
+	InterlockedExchange(&Recorder->Recording, TRUE);
+
+	KeReleaseSpinLock(&Recorder->Lock, irql);
+
+	if (previous != NULL) {
+		ExFreePoolWithTag(previous, HAPTICS_POOL_TAG);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+SamsungHapticsRecorderStop(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder
+)
+/*++
+Routine Description:
+
+	Stop capturing. The ring is kept until it is read or replaced.
+
+--*/
+{
+	PAGED_CODE();
+
+	InterlockedExchange(&Recorder->Recording, FALSE);
+}
+
+NTSTATUS
+SamsungHapticsRecorderRead(
+	_In_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_Out_writes_bytes_(OutputLength) PVOID Output,
+	_In_ size_t OutputLength,
+	_Out_ size_t* Written
+)
+/*++
+Routine Description:
+
+	Copy the recording out, oldest record first. If the records do not
+	fit, only the header is returned so the caller can size its buffer.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_RECORDING recording = (PSAMSUNG_HAPTICS_RECORDING)Output;
+	NTSTATUS status = STATUS_SUCCESS;
+	KIRQL irql;
+
+	*Written = 0;
+
+	if (OutputLength < sizeof(SAMSUNG_HAPTICS_RECORDING)) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	KeAcquireSpinLock(&Recorder->Lock, &irql);
+
+	recording->Version = SAMSUNG_HAPTICS_RECORDING_VERSION;
+	recording->Records = Recorder->Records;
+	recording->Overwritten = Recorder->Overwritten;
+	recording->Length = Recorder->Used;
+
+	if (OutputLength - sizeof(SAMSUNG_HAPTICS_RECORDING) < Recorder->Used) {
+		*Written = sizeof(SAMSUNG_HAPTICS_RECORDING);
+		status = STATUS_BUFFER_OVERFLOW;
+	}
+	else {
+		if (Recorder->Used != 0) {
+			SamsungHapticsRecorderRingRead(Recorder, Recorder->Head, recording + 1, Recorder->Used);
+		}
+
+		*Written = sizeof(SAMSUNG_HAPTICS_RECORDING) + Recorder->Used;
+	}
+
+	KeReleaseSpinLock(&Recorder->Lock, irql);
+
+	return status;
+}
+
+NTSTATUS
+SamsungHapticsRecorderReplay(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ WDFREQUEST Request,
+	_In_reads_bytes_(InputLength) const SAMSUNG_HAPTICS_REPLAY* Replay,
+	_In_ size_t InputLength,
+	_Out_ PSAMSUNG_HAPTICS_REPLAY_RESULT Result
+)
+/*++
+Routine Description:
+
+	Feed a recording through the HwN callbacks of this device, honoring
+	the recorded gaps scaled by the replay speed, for at most
+	SAMSUNG_HAPTICS_REPLAY_MAX_DURATION_MS.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_RECORDER recorder = &devContext->Recorder;
+	const UCHAR* cursor = (const UCHAR*)(Replay + 1);
+	const UCHAR* end;
+	PUCHAR buffer;
+	ULONGLONG previous = 0;
+	ULONGLONG deadline;
+	NTSTATUS replayStatus = STATUS_SUCCESS;
+	LONG64 pinWrites;
+	SAMSUNG_HAPTICS_CPU_COUNTERS counters;
+
+	PAGED_CODE();
+
+	RtlZeroMemory(Result, sizeof(*Result));
+
+	if (Replay->Recording.Version != SAMSUNG_HAPTICS_RECORDING_VERSION ||
+		Replay->Recording.Length > InputLength - sizeof(SAMSUNG_HAPTICS_REPLAY) ||
+		Replay->SpeedPercent > SAMSUNG_HAPTICS_REPLAY_MAX_SPEED) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	end = cursor + Replay->Recording.Length;
+
+	buffer = (PUCHAR)ExAllocatePool2(POOL_FLAG_PAGED, SAMSUNG_HAPTICS_RECORD_MAX_PAYLOAD, HAPTICS_POOL_TAG);
+	if (buffer == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	InterlockedExchange(&recorder->Replaying, TRUE);
+	SamsungHapticsCpuCountersSum(devContext, &counters);
+	pinWrites = counters.PinWrites;
+	deadline = KeQueryInterruptTime() + (ULONGLONG)SAMSUNG_HAPTICS_REPLAY_MAX_DURATION_MS * 10000;
+
+	while ((size_t)(end - cursor) >= sizeof(SAMSUNG_HAPTICS_RECORD))
+	{
+		SAMSUNG_HAPTICS_RECORD record;
+		LARGE_INTEGER start;
+		NTSTATUS status;
+		ULONGLONG now;
+		ULONGLONG gap = 0;
+		ULONG bytes = 0;
+
+		RtlCopyMemory(&record, cursor, sizeof(record));
+
+		if (record.Size < sizeof(record) ||
+			record.Size > (size_t)(end - cursor) ||
+			record.Length > record.Size - sizeof(record) ||
+			record.Length > SAMSUNG_HAPTICS_RECORD_MAX_PAYLOAD) {
+			break;
+		}
+
+		if (previous != 0 && Replay->SpeedPercent != 0 && record.Timestamp > previous) {
+			gap = min(
+				(record.Timestamp - previous) * 100 / Replay->SpeedPercent,
+				(ULONGLONG)SAMSUNG_HAPTICS_REPLAY_MAX_GAP_MS * 10000);
+		}
+
+		now = KeQueryInterruptTime();
+		if (now + gap >= deadline) {
+			Result->Truncated = TRUE;
+			break;
+		}
+
+		replayStatus = SamsungHapticsRecorderReplayWait(recorder, Request, gap);
+		if (!NT_SUCCESS(replayStatus)) {
+			break;
+		}
+
+		previous = record.Timestamp;
+
+		start = KeQueryPerformanceCounter(NULL);
+
+		if (record.Type == SamsungHapticsRecordSetState) {
+			RtlCopyMemory(buffer, cursor + sizeof(record), record.Length);
+			status = SamsungHapticsSetState(devContext, buffer, record.Length, &bytes);
+			SamsungHapticsLatencyAdd(&Result->SetState, SamsungHapticsElapsedUs(start));
+		}
+		else if (record.Type == SamsungHapticsRecordGetState) {
+			status = SamsungHapticsGetState(devContext, buffer, record.Length, NULL, 0, &bytes);
+			SamsungHapticsLatencyAdd(&Result->GetState, SamsungHapticsElapsedUs(start));
+		}
+		else {
+			cursor += record.Size;
+			continue;
+		}
+
+		Result->Records++;
+
+		if (!NT_SUCCESS(status)) {
+			Result->Failures++;
+		}
+
+		if (status != record.Status) {
+			Result->Mismatches++;
+		}
+
+		cursor += record.Size;
+	}
+
+	SamsungHapticsCpuCountersSum(devContext, &counters);
+	Result->PinWrites = (ULONGLONG)(counters.PinWrites - pinWrites);
+	InterlockedExchange(&recorder->Replaying, FALSE);
+
+	ExFreePoolWithTag(buffer, HAPTICS_POOL_TAG);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_HAPTICS,
+		"Replayed %u records: %u failed, %u mismatched, %llu pin writes - %!STATUS!",
+		Result->Records,
+		Result->Failures,
+		Result->Mismatches,
+		Result->PinWrites,
+		replayStatus);
+
+	return replayStatus;
+}
@@ -0,0 +1,107 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Recorder.h
+
+Abstract:
+
+	HwN request recorder definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+typedef struct _SAMSUNG_HAPTICS_RECORDER
+{
+	KSPIN_LOCK    Lock;
+
+	//
+	// Byte ring of packed records. Head is the oldest record, Used the
+	// bytes in use from there, wrapping at RingSize.
+	//
+	PUCHAR        Ring;
+	ULONG         RingSize;
+	ULONG         Head;
+	ULONG         Used;
+	ULONG         Records;
+	ULONG         Overwritten;
+
+	volatile LONG Recording;
+	volatile LONG Replaying;    // replayed callbacks are not captured
+
+	//
+	// Signaled when the device goes away, so that a replay holding it
+	// stops at the next record
+	//
+	KEVENT        Abort;
+} SAMSUNG_HAPTICS_RECORDER, * PSAMSUNG_HAPTICS_RECORDER;
+
+struct _DEVICE_CONTEXT;
+
+VOID
+SamsungHapticsRecorderInitialize(
+	_Out_ PSAMSUNG_HAPTICS_RECORDER Recorder
+);
+
+VOID
+SamsungHapticsRecorderUninitialize(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder
+);
+
+VOID
+SamsungHapticsRecorderCapture(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_In_ SAMSUNG_HAPTICS_RECORD_TYPE Type,
+	_In_ NTSTATUS Status,
+	_In_ ULONGLONG Timestamp,
+	_In_ LARGE_INTEGER Start,
+	_In_reads_bytes_(Length) PVOID Payload,
+	_In_ ULONG Length
+);
+
+NTSTATUS
+SamsungHapticsRecorderStart(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_In_ ULONG RingSize
+);
+
+VOID
+SamsungHapticsRecorderStop(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder
+);
+
+NTSTATUS
+SamsungHapticsRecorderRead(
+	_In_ PSAMSUNG_HAPTICS_RECORDER Recorder,
+	_Out_writes_bytes_(OutputLength) PVOID Output,
+	_In_ size_t OutputLength,
+	_Out_ size_t* Written
+);
+
+VOID
+SamsungHapticsRecorderAbort(
+	_Inout_ PSAMSUNG_HAPTICS_RECORDER Recorder
+);
+
+NTSTATUS
+SamsungHapticsRecorderReplay(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ WDFREQUEST Request,
+	_In_reads_bytes_(InputLength) const SAMSUNG_HAPTICS_REPLAY* Replay,
+	_In_ size_t InputLength,
+	_Out_ PSAMSUNG_HAPTICS_REPLAY_RESULT Result
+);
+
+EXTERN_C_END
@@ -0,0 +1,207 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Saver.c - Battery saver intensity scaling
+
+Abstract:
+
+	While the system battery saver is on (or when forced from the control
+	device), every effect on every motor is made cheaper instead of being
+	disabled: the output intensity is scaled down and effects are cut at a
+	maximum pulse length. The scale only reduces energy on modulated
+	effects, since an unmodulated motor is either fully on or off; the
+	pulse limit applies to all of them.
+
+	Configuration changes are serialized by a mutex and published to the
+	output path as a single packed value with one interlocked exchange, so
+	an effect never sees the scale of one mode with the pulse limit of
+	another.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "saver.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsSaverInitialize)
+#pragma alloc_text (PAGE, SamsungHapticsSaverUninitialize)
+#pragma alloc_text (PAGE, SamsungHapticsSaverConfigure)
+#pragma alloc_text (PAGE, SamsungHapticsSaverQuery)
+#endif
+
+volatile LONG SamsungHapticsSaverParameters = SAMSUNG_HAPTICS_SAVER_PACK(SAMSUNG_HAPTICS_MAX_INTENSITY, 0);
+
+static FAST_MUTEX SamsungHapticsSaverMutex;
+static PVOID SamsungHapticsSaverCallbackHandle = NULL;
+static BOOLEAN SamsungHapticsSaverSystem = FALSE;
+static SAMSUNG_HAPTICS_SAVER_CONFIG SamsungHapticsSaverConfig =
+{
+	0,
+	SamsungHapticsSaverAuto,
+	SAMSUNG_HAPTICS_SAVER_DEFAULT_SCALE,
+	SAMSUNG_HAPTICS_SAVER_DEFAULT_MAX_PULSE_MS
+};
+
+static
+BOOLEAN
+SamsungHapticsSaverIsActive(
+	VOID
+)
+{
+	return SamsungHapticsSaverConfig.Mode == SamsungHapticsSaverOn ||
+		(SamsungHapticsSaverConfig.Mode == SamsungHapticsSaverAuto && SamsungHapticsSaverSystem);
+}
+
+static
+VOID
+SamsungHapticsSaverPublish(
+	VOID
+)
+/*++
+Routine Description:
+
+	Publish the effective scaling. Must be called with the mutex held.
+
+--*/
+{
+	LONG parameters = SAMSUNG_HAPTICS_SAVER_PACK(SAMSUNG_HAPTICS_MAX_INTENSITY, 0);
+
+	if (SamsungHapticsSaverIsActive()) {
+		parameters = SAMSUNG_HAPTICS_SAVER_PACK(
+			SamsungHapticsSaverConfig.ScalePercent,
+			SamsungHapticsSaverConfig.MaxPulseMs);
+	}
+
+	InterlockedExchange(&SamsungHapticsSaverParameters, parameters);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_HAPTICS,
+		"Battery saver scaling %s: %u%%, max pulse %u ms",
+		SamsungHapticsSaverIsActive() ? "on" : "off",
+		SamsungHapticsSaverScalePercent(parameters),
+		SamsungHapticsSaverMaxPulseMs(parameters));
+}
+
+static
+NTSTATUS
+SamsungHapticsSaverPowerSettingCallback(
+	_In_ LPCGUID SettingGuid,
+	_In_reads_bytes_(ValueLength) PVOID Value,
+	_In_ ULONG ValueLength,
+	_Inout_opt_ PVOID Context
+)
+{
+	UNREFERENCED_PARAMETER(Context);
+
+	if (!IsEqualGUID(SettingGuid, &GUID_POWER_SAVING_STATUS) || ValueLength < sizeof(ULONG)) {
+		return STATUS_SUCCESS;
+	}
+
+	ExAcquireFastMutex(&SamsungHapticsSaverMutex);
+	SamsungHapticsSaverSystem = (*(PULONG)Value != 0);
+	SamsungHapticsSaverPublish();
+	ExReleaseFastMutex(&SamsungHapticsSaverMutex);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+SamsungHapticsSaverInitialize(
+	VOID
+)
+/*++
+Routine Description:
+
+	Follow the system battery saver. The power manager calls back once at
+	registration with the current state.
+
+--*/
+{
+	NTSTATUS status;
+
+	PAGED_CODE();
+
+	ExInitializeFastMutex(&SamsungHapticsSaverMutex);
+
+	status = PoRegisterPowerSettingCallback(
+		NULL,
+		&GUID_POWER_SAVING_STATUS,
+		SamsungHapticsSaverPowerSettingCallback,
+		NULL,
+		&SamsungHapticsSaverCallbackHandle);
+	if (!NT_SUCCESS(status)) {
+		SamsungHapticsSaverCallbackHandle = NULL;
+	}
+
+	return status;
+}
+
+VOID
+SamsungHapticsSaverUninitialize(
+	VOID
+)
+{
+	PAGED_CODE();
+
+	if (SamsungHapticsSaverCallbackHandle != NULL) {
+		PoUnregisterPowerSettingCallback(SamsungHapticsSaverCallbackHandle);
+		SamsungHapticsSaverCallbackHandle = NULL;
+	}
+}
+
+NTSTATUS
+SamsungHapticsSaverConfigure(
+	_In_ const SAMSUNG_HAPTICS_SAVER_CONFIG* Config
+)
+{
+	PAGED_CODE();
+
+	if (Config->Mode >= SamsungHapticsSaverMaximum ||
+		Config->ScalePercent == 0 ||
+		Config->ScalePercent > SAMSUNG_HAPTICS_MAX_INTENSITY ||
+		Config->MaxPulseMs > SAMSUNG_HAPTICS_SAVER_MAX_PULSE_MS)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	ExAcquireFastMutex(&SamsungHapticsSaverMutex);
+	SamsungHapticsSaverConfig = *Config;
+	SamsungHapticsSaverConfig.DeviceIndex = 0;
+	SamsungHapticsSaverPublish();
+	ExReleaseFastMutex(&SamsungHapticsSaverMutex);
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+SamsungHapticsSaverQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_SAVER_STATISTICS Statistics
+)
+{
+	PSAMSUNG_HAPTICS_SAVER_COUNTERS counters = &devContext->Effect.Saver;
+
+	PAGED_CODE();
+
+	ExAcquireFastMutex(&SamsungHapticsSaverMutex);
+	Statistics->Config = SamsungHapticsSaverConfig;
+	Statistics->Config.DeviceIndex = devContext->RegistryIndex;
+	Statistics->SystemSaver = SamsungHapticsSaverSystem;
+	Statistics->Active = SamsungHapticsSaverIsActive();
+	ExReleaseFastMutex(&SamsungHapticsSaverMutex);
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+	Statistics->Truncations = counters->Truncations;
+	Statistics->TruncatedOnTimeMs = counters->TruncatedTime / 10000;
+	Statistics->ScaledOnTimeMs = counters->ScaledTime / 10000;
+	WdfWaitLockRelease(devContext->OutputLock);
+}
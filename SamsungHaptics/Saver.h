@@ -0,0 +1,86 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Saver.h
+
+Abstract:
+
+	Battery saver scaling definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+//
+// Effective scaling, packed so the output path reads it with one load:
+// bits 0-7 intensity scale in percent, bits 8-31 maximum pulse in ms
+// (0 = no limit). Scaling is off when it reads 100 / 0.
+//
+#define SAMSUNG_HAPTICS_SAVER_PACK(ScalePercent, MaxPulseMs) ((LONG)((ScalePercent) | ((MaxPulseMs) << 8)))
+
+extern volatile LONG SamsungHapticsSaverParameters;
+
+FORCEINLINE
+ULONG
+SamsungHapticsSaverScalePercent(
+	_In_ LONG Parameters
+)
+{
+	return (ULONG)Parameters & 0xFF;
+}
+
+FORCEINLINE
+ULONG
+SamsungHapticsSaverMaxPulseMs(
+	_In_ LONG Parameters
+)
+{
+	return (ULONG)Parameters >> 8;
+}
+
+//
+// Per-device savings, updated by the effect engine under OutputLock
+//
+typedef struct _SAMSUNG_HAPTICS_SAVER_COUNTERS
+{
+	ULONGLONG Truncations;
+	ULONGLONG TruncatedTime;    // 100 ns units
+	ULONGLONG ScaledTime;       // 100 ns units of full-drive equivalent
+} SAMSUNG_HAPTICS_SAVER_COUNTERS, * PSAMSUNG_HAPTICS_SAVER_COUNTERS;
+
+struct _DEVICE_CONTEXT;
+
+NTSTATUS
+SamsungHapticsSaverInitialize(
+	VOID
+);
+
+VOID
+SamsungHapticsSaverUninitialize(
+	VOID
+);
+
+NTSTATUS
+SamsungHapticsSaverConfigure(
+	_In_ const SAMSUNG_HAPTICS_SAVER_CONFIG* Config
+);
+
+VOID
+SamsungHapticsSaverQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_SAVER_STATISTICS Statistics
+);
+
+EXTERN_C_END
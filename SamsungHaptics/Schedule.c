@@ -0,0 +1,297 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Schedule.c - Compiled effect schedule cache
+
+Abstract:
+
+	The same few library effects (keyboard ticks, notifications) are
+	played over and over at the same intensity. Rather than scaling the
+	library steps on every step change, each (effect, intensity) pair is
+	compiled once into a schedule: steps scaled to the requested
+	intensity, neighbours of equal intensity merged, pulses shorter than
+	the profile's minimum stretched into the pause that follows them, and
+	trailing pauses dropped. The mixer voice then walks the schedule as
+	authored.
+
+	Schedules live in a small fixed-capacity cache keyed by a hash of the
+	effect id and intensity, with least recently used eviction. A schedule
+	a voice is still walking is never evicted. Reloading the profile or the
+	library invalidates every schedule; ones still playing finish with the
+	timing they started with.
+
+	All routines but the IOCTL handler run with OutputLock held.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "schedule.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsScheduleQuery)
+#endif
+
+VOID
+SamsungHapticsScheduleCacheInitialize(
+	_Out_ PSAMSUNG_HAPTICS_SCHEDULE_CACHE Cache
+)
+{
+	RtlZeroMemory(Cache, sizeof(*Cache));
+}
+
+VOID
+SamsungHapticsScheduleCacheFlush(
+	_Inout_ PSAMSUNG_HAPTICS_SCHEDULE_CACHE Cache
+)
+{
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_SCHEDULE_CACHE_ENTRIES; i++) {
+		Cache->Entries[i].Valid = FALSE;
+	}
+
+	Cache->Flushes++;
+}
+
+static
+ULONG
+SamsungHapticsScheduleHash(
+	_In_ ULONG EffectId,
+	_In_ ULONG Scale
+)
+/*++
+Routine Description:
+
+	FNV-1a over the key, so a lookup compares one word per entry.
+
+--*/
+{
+	ULONG key[2] = { EffectId, Scale };
+	const UCHAR* bytes = (const UCHAR*)key;
+	ULONG hash = 2166136261UL;
+	ULONG i;
+
+	for (i = 0; i < sizeof(key); i++) {
+		hash = (hash ^ bytes[i]) * 16777619UL;
+	}
+
+	return hash;
+}
+
+static
+BOOLEAN
+SamsungHapticsScheduleInUse(
+	_In_ PDEVICE_CONTEXT devContext,
+	_In_ PCSAMSUNG_HAPTICS_SCHEDULE Schedule
+)
+{
+	ULONG i;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_MIXER_VOICES; i++) {
+		const SAMSUNG_HAPTICS_VOICE* voice = &devContext->Mixer.Voices[i];
+
+		if (voice->Source != SamsungHapticsVoiceFree &&
+			voice->Step >= Schedule->Steps &&
+			voice->Step < Schedule->Steps + SAMSUNG_HAPTICS_LIBRARY_MAX_STEPS) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static
+ULONG
+SamsungHapticsScheduleCompact(
+	_Inout_updates_(Count) PSAMSUNG_HAPTICS_LIBRARY_STEP Steps,
+	_In_ ULONG Count
+)
+/*++
+Routine Description:
+
+	Drop empty steps and merge neighbours of equal intensity in place.
+
+--*/
+{
+	ULONG out = 0;
+	ULONG i;
+
+	for (i = 0; i < Count; i++) {
+		if (Steps[i].DurationMs == 0) {
+			continue;
+		}
+
+		if (out != 0 && Steps[out - 1].Intensity == Steps[i].Intensity) {
+			Steps[out - 1].DurationMs += Steps[i].DurationMs;
+			continue;
+		}
+
+		Steps[out++] = Steps[i];
+	}
+
+	return out;
+}
+
+static
+VOID
+SamsungHapticsScheduleCompile(
+	_Out_ PSAMSUNG_HAPTICS_SCHEDULE Schedule,
+	_In_reads_(StepCount) const SAMSUNG_HAPTICS_LIBRARY_STEP* Steps,
+	_In_ ULONG StepCount,
+	_In_ ULONG Scale,
+	_In_ ULONG MinimumPulseMs
+)
+{
+	ULONG count;
+	ULONG i;
+
+	//
+	// Library validation bounds the step count, intensities and total
+	// duration, so the schedule fits and merged durations stay in range.
+	//
+	for (i = 0; i < StepCount; i++) {
+		Schedule->Steps[i].Intensity = (UCHAR)((Steps[i].Intensity * Scale + SAMSUNG_HAPTICS_MAX_INTENSITY - 1) / SAMSUNG_HAPTICS_MAX_INTENSITY);
+		Schedule->Steps[i].Reserved = 0;
+		Schedule->Steps[i].DurationMs = Steps[i].DurationMs;
+	}
+
+	count = SamsungHapticsScheduleCompact(Schedule->Steps, StepCount);
+
+	if (MinimumPulseMs != 0) {
+		for (i = 0; i + 1 < count; i++) {
+			PSAMSUNG_HAPTICS_LIBRARY_STEP pulse = &Schedule->Steps[i];
+			PSAMSUNG_HAPTICS_LIBRARY_STEP pause = &Schedule->Steps[i + 1];
+
+			if (pulse->Intensity != 0 && pause->Intensity == 0 && pulse->DurationMs < MinimumPulseMs) {
+				USHORT borrow = (USHORT)min(MinimumPulseMs - pulse->DurationMs, pause->DurationMs);
+
+				pulse->DurationMs += borrow;
+				pause->DurationMs -= borrow;
+			}
+		}
+
+		count = SamsungHapticsScheduleCompact(Schedule->Steps, count);
+	}
+
+	while (count > 1 && Schedule->Steps[count - 1].Intensity == 0) {
+		count--;
+	}
+
+	Schedule->StepCount = count;
+}
+
+PCSAMSUNG_HAPTICS_SCHEDULE
+SamsungHapticsScheduleLookup(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONG EffectId,
+	_In_ ULONG Intensity,
+	_In_reads_(StepCount) const SAMSUNG_HAPTICS_LIBRARY_STEP* Steps,
+	_In_ ULONG StepCount
+)
+/*++
+Routine Description:
+
+	Return the compiled schedule of a library effect at an intensity,
+	compiling it into the least recently used free slot on a miss.
+
+Return Value:
+
+	The schedule, or NULL if every slot holds a schedule being played.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_SCHEDULE_CACHE cache = &devContext->ScheduleCache;
+	PSAMSUNG_HAPTICS_SCHEDULE victim = NULL;
+	ULONG scale;
+	ULONG hash;
+	ULONG i;
+
+	//
+	// 0 keeps its HwN meaning of "as authored".
+	//
+	scale = (Intensity == 0 || Intensity >= SAMSUNG_HAPTICS_MAX_INTENSITY) ? SAMSUNG_HAPTICS_MAX_INTENSITY : Intensity;
+	hash = SamsungHapticsScheduleHash(EffectId, scale);
+
+	cache->Clock++;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_SCHEDULE_CACHE_ENTRIES; i++) {
+		PSAMSUNG_HAPTICS_SCHEDULE entry = &cache->Entries[i];
+
+		if (entry->Valid && entry->Hash == hash && entry->EffectId == EffectId && entry->Scale == scale) {
+			entry->LastUsed = cache->Clock;
+			cache->Hits++;
+			return entry;
+		}
+	}
+
+	cache->Misses++;
+
+	for (i = 0; i < SAMSUNG_HAPTICS_SCHEDULE_CACHE_ENTRIES; i++) {
+		PSAMSUNG_HAPTICS_SCHEDULE entry = &cache->Entries[i];
+
+		if (SamsungHapticsScheduleInUse(devContext, entry)) {
+			continue;
+		}
+
+		if (victim == NULL ||
+			(victim->Valid && !entry->Valid) ||
+			(victim->Valid == entry->Valid && entry->LastUsed < victim->LastUsed)) {
+			victim = entry;
+		}
+	}
+
+	if (victim == NULL) {
+		return NULL;
+	}
+
+	if (victim->Valid) {
+		cache->Evictions++;
+	}
+
+	SamsungHapticsScheduleCompile(victim, Steps, StepCount, scale, devContext->Profile->MinimumPulseMs);
+
+	victim->Hash = hash;
+	victim->EffectId = (USHORT)EffectId;
+	victim->Scale = (USHORT)scale;
+	victim->LastUsed = cache->Clock;
+	victim->Valid = TRUE;
+
+	return victim;
+}
+
+VOID
+SamsungHapticsScheduleQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_SCHEDULE_STATISTICS Statistics
+)
+{
+	PSAMSUNG_HAPTICS_SCHEDULE_CACHE cache = &devContext->ScheduleCache;
+	ULONG i;
+
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	Statistics->Entries = 0;
+	for (i = 0; i < SAMSUNG_HAPTICS_SCHEDULE_CACHE_ENTRIES; i++) {
+		if (cache->Entries[i].Valid) {
+			Statistics->Entries++;
+		}
+	}
+
+	Statistics->Reserved = 0;
+	Statistics->Hits = cache->Hits;
+	Statistics->Misses = cache->Misses;
+	Statistics->Evictions = cache->Evictions;
+	Statistics->Flushes = cache->Flushes;
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
@@ -0,0 +1,82 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Schedule.h
+
+Abstract:
+
+	Compiled effect schedule cache definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+//
+// A library effect expanded for one requested intensity under the current
+// profile: steps scaled, merged and with short pulses stretched, ready to
+// be walked by a mixer voice as authored.
+//
+typedef struct _SAMSUNG_HAPTICS_SCHEDULE
+{
+	ULONG     Hash;
+	USHORT    EffectId;
+	USHORT    Scale;
+	BOOLEAN   Valid;
+	ULONG     StepCount;
+	ULONGLONG LastUsed;
+	SAMSUNG_HAPTICS_LIBRARY_STEP Steps[SAMSUNG_HAPTICS_LIBRARY_MAX_STEPS];
+} SAMSUNG_HAPTICS_SCHEDULE, * PSAMSUNG_HAPTICS_SCHEDULE;
+
+typedef const SAMSUNG_HAPTICS_SCHEDULE* PCSAMSUNG_HAPTICS_SCHEDULE;
+
+typedef struct _SAMSUNG_HAPTICS_SCHEDULE_CACHE
+{
+	SAMSUNG_HAPTICS_SCHEDULE Entries[SAMSUNG_HAPTICS_SCHEDULE_CACHE_ENTRIES];
+	ULONGLONG Clock;         // bumped on every lookup, orders LastUsed
+
+	ULONGLONG Hits;
+	ULONGLONG Misses;
+	ULONGLONG Evictions;
+	ULONGLONG Flushes;
+} SAMSUNG_HAPTICS_SCHEDULE_CACHE, * PSAMSUNG_HAPTICS_SCHEDULE_CACHE;
+
+struct _DEVICE_CONTEXT;
+
+VOID
+SamsungHapticsScheduleCacheInitialize(
+	_Out_ PSAMSUNG_HAPTICS_SCHEDULE_CACHE Cache
+);
+
+VOID
+SamsungHapticsScheduleCacheFlush(
+	_Inout_ PSAMSUNG_HAPTICS_SCHEDULE_CACHE Cache
+);
+
+PCSAMSUNG_HAPTICS_SCHEDULE
+SamsungHapticsScheduleLookup(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONG EffectId,
+	_In_ ULONG Intensity,
+	_In_reads_(StepCount) const SAMSUNG_HAPTICS_LIBRARY_STEP* Steps,
+	_In_ ULONG StepCount
+);
+
+VOID
+SamsungHapticsScheduleQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_SCHEDULE_STATISTICS Statistics
+);
+
+EXTERN_C_END
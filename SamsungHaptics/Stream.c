@@ -0,0 +1,548 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Stream.c - Shared-memory intensity stream
+
+Abstract:
+
+	Continuous effects (racing games, rumble) change intensity hundreds of
+	times a second, and sending each change through HwnClx costs a request
+	with its validation and copies. Instead, a client can share a ring of
+	timestamped intensity samples with the driver: it appends samples and
+	advances the producer index, and the effect timer polls the ring,
+	applies the newest sample that is due to a mixer voice of its own and
+	advances the consumer index. Nothing is copied or sent per sample.
+
+	The ring is the output buffer of a direct I/O attach request that stays
+	pending in a manual queue while the stream is attached, so the I/O
+	manager keeps it locked and cancels the request, ending the stream,
+	when the client exits. The client can write the ring at any time:
+	the producer index is validated on every poll and samples are read
+	once, field by field.
+
+	The ring is polled every millisecond while the stream voice plays and
+	every 8 ms while it is silent. A voice left playing without new samples
+	for 100 ms is stopped. Clients without a stream keep using HwN or
+	IOCTL_SAMSUNG_HAPTICS_PLAY, which mix with the stream as usual.
+
+	Stream state is protected by OutputLock.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "stream.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsStreamQueueCreate)
+#pragma alloc_text (PAGE, SamsungHapticsStreamAttach)
+#pragma alloc_text (PAGE, SamsungHapticsStreamDetach)
+#pragma alloc_text (PAGE, SamsungHapticsStreamRundown)
+#pragma alloc_text (PAGE, SamsungHapticsStreamQuery)
+#endif
+
+#define STREAM_ACTIVE_POLL (1 * 10000)     // 1 ms in interrupt time
+#define STREAM_IDLE_POLL   (8 * 10000)
+#define STREAM_TIMEOUT     (100 * 10000)
+
+typedef struct _SAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT
+{
+	PDEVICE_CONTEXT Device;
+	ULONGLONG       Generation;
+} SAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT, * PSAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(SAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT, SamsungHapticsStreamGetRequestContext)
+
+EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE SamsungHapticsEvtStreamCanceledOnQueue;
+
+//
+// Attach requests of every device, pending while their stream is attached
+//
+static WDFQUEUE SamsungHapticsStreamQueue = NULL;
+
+VOID
+SamsungHapticsStreamInitialize(
+	_Out_ PSAMSUNG_HAPTICS_STREAM_STATE Stream
+)
+{
+	RtlZeroMemory(Stream, sizeof(*Stream));
+	KeInitializeEvent(&Stream->Released, NotificationEvent, TRUE);
+}
+
+NTSTATUS
+SamsungHapticsStreamQueueCreate(
+	_In_ WDFDEVICE ControlDevice
+)
+/*++
+Routine Description:
+
+	Create the manual queue holding attach requests on the control device.
+	Cancellation is delivered at PASSIVE_LEVEL since ending a stream takes
+	OutputLock.
+
+--*/
+{
+	NTSTATUS status;
+	WDF_IO_QUEUE_CONFIG queueConfig;
+	WDF_OBJECT_ATTRIBUTES attributes;
+
+	PAGED_CODE();
+
+	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
+	queueConfig.EvtIoCanceledOnQueue = SamsungHapticsEvtStreamCanceledOnQueue;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+	status = WdfIoQueueCreate(ControlDevice, &queueConfig, &attributes, &SamsungHapticsStreamQueue);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfIoQueueCreate failed %!STATUS!", status);
+	}
+
+	return status;
+}
+
+static
+VOID
+SamsungHapticsStreamEnd(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Stop using the ring and silence the stream voice. Must be called with
+	OutputLock held.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+
+	stream->Request = NULL;
+	stream->Ring = NULL;
+	stream->Capacity = 0;
+	stream->NextPoll = 0;
+
+	if (stream->Intensity != 0) {
+		stream->Intensity = 0;
+		SamsungHapticsMixerClearVoice(devContext, SamsungHapticsVoiceStream);
+	}
+
+	SamsungHapticsEffectReschedule(devContext);
+}
+
+static
+VOID
+SamsungHapticsStreamRequestDone(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Account for a completed attach request. The device must not be used
+	once this returns.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	if (--stream->Outstanding == 0) {
+		KeSetEvent(&stream->Released, IO_NO_INCREMENT, FALSE);
+	}
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
+
+VOID
+SamsungHapticsEvtStreamCanceledOnQueue(
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request
+)
+/*++
+Routine Description:
+
+	The client cancelled its attach request or exited: end its stream if it
+	is still attached and release the ring.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT requestContext = SamsungHapticsStreamGetRequestContext(Request);
+	PDEVICE_CONTEXT devContext = requestContext->Device;
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+
+	UNREFERENCED_PARAMETER(Queue);
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	if (stream->Request == Request && stream->Generation == requestContext->Generation) {
+		SamsungHapticsStreamEnd(devContext);
+	}
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	WdfRequestComplete(Request, STATUS_CANCELLED);
+	SamsungHapticsStreamRequestDone(devContext);
+}
+
+NTSTATUS
+SamsungHapticsStreamAttach(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ WDFREQUEST Request
+)
+/*++
+Routine Description:
+
+	Attach the ring in the output buffer of an attach request and start
+	polling it. The request stays pending until the stream is detached.
+
+Return Value:
+
+	STATUS_PENDING once attached, else the error to complete the request
+	with.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+	PSAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT requestContext;
+	PSAMSUNG_HAPTICS_STREAM_RING ring;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	NTSTATUS status;
+	PMDL mdl;
+	ULONG length;
+	ULONG capacity;
+	ULONGLONG generation;
+
+	PAGED_CODE();
+
+	status = WdfRequestRetrieveOutputWdmMdl(Request, &mdl);
+	if (!NT_SUCCESS(status)) {
+		return status;
+	}
+
+	length = MmGetMdlByteCount(mdl);
+	if (length < FIELD_OFFSET(SAMSUNG_HAPTICS_STREAM_RING, Samples) +
+		SAMSUNG_HAPTICS_STREAM_MIN_SAMPLES * sizeof(SAMSUNG_HAPTICS_STREAM_SAMPLE)) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	if ((MmGetMdlByteOffset(mdl) & (SAMSUNG_HAPTICS_STREAM_ALIGNMENT - 1)) != 0) {
+		return STATUS_DATATYPE_MISALIGNMENT;
+	}
+
+	//
+	// Use the largest power of 2 that fits, so indices wrap cleanly.
+	//
+	capacity = (length - FIELD_OFFSET(SAMSUNG_HAPTICS_STREAM_RING, Samples)) / sizeof(SAMSUNG_HAPTICS_STREAM_SAMPLE);
+	capacity = min(capacity, SAMSUNG_HAPTICS_STREAM_MAX_SAMPLES);
+	while ((capacity & (capacity - 1)) != 0) {
+		capacity &= capacity - 1;
+	}
+
+	ring = (PSAMSUNG_HAPTICS_STREAM_RING)MmGetSystemAddressForMdlSafe(mdl, NormalPagePriority | MdlMappingNoExecute);
+	if (ring == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, SAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT);
+	status = WdfObjectAllocateContext(Request, &attributes, (PVOID*)&requestContext);
+	if (!NT_SUCCESS(status)) {
+		return status;
+	}
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	if (stream->Request != NULL) {
+		WdfWaitLockRelease(devContext->OutputLock);
+		return STATUS_DEVICE_BUSY;
+	}
+
+	generation = ++stream->Attaches;
+	requestContext->Device = devContext;
+	requestContext->Generation = generation;
+
+	ring->Capacity = capacity;
+	WriteULongRelease(&ring->Consumer, 0);
+
+	stream->Request = Request;
+	stream->Generation = generation;
+	stream->Ring = ring;
+	stream->Capacity = capacity;
+	stream->Consumer = 0;
+	stream->Intensity = 0;
+	stream->LastSample = KeQueryInterruptTime();
+	stream->NextPoll = stream->LastSample;
+
+	if (stream->Outstanding++ == 0) {
+		KeClearEvent(&stream->Released);
+	}
+
+	SamsungHapticsEffectReschedule(devContext);
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	status = WdfRequestForwardToIoQueue(Request, SamsungHapticsStreamQueue);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_HAPTICS, "WdfRequestForwardToIoQueue failed - %!STATUS!", status);
+
+		WdfWaitLockAcquire(devContext->OutputLock, NULL);
+		if (stream->Request == Request && stream->Generation == generation) {
+			SamsungHapticsStreamEnd(devContext);
+		}
+		WdfWaitLockRelease(devContext->OutputLock);
+
+		SamsungHapticsStreamRequestDone(devContext);
+		return status;
+	}
+
+	Trace(TRACE_LEVEL_INFORMATION, TRACE_HAPTICS, "Stream attached, %u samples", capacity);
+
+	return STATUS_PENDING;
+}
+
+NTSTATUS
+SamsungHapticsStreamDetach(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	End the attached stream and complete its attach request, unless a
+	concurrent cancellation already owns it.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+	NTSTATUS status;
+	WDFREQUEST attached;
+	WDFREQUEST previous = NULL;
+	WDFREQUEST found;
+	ULONGLONG generation;
+
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	attached = stream->Request;
+	generation = stream->Generation;
+	if (attached != NULL) {
+		SamsungHapticsStreamEnd(devContext);
+	}
+
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	if (attached == NULL) {
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	//
+	// Look the request up by its context rather than its handle: once it
+	// is cancelled the handle may name a later request.
+	//
+	for (;;) {
+		PSAMSUNG_HAPTICS_STREAM_REQUEST_CONTEXT requestContext;
+
+		status = WdfIoQueueFindRequest(SamsungHapticsStreamQueue, previous, NULL, NULL, &found);
+		if (previous != NULL) {
+			WdfObjectDereference(previous);
+		}
+		if (!NT_SUCCESS(status)) {
+			break;
+		}
+
+		requestContext = SamsungHapticsStreamGetRequestContext(found);
+		if (requestContext->Device == devContext && requestContext->Generation == generation) {
+			status = WdfIoQueueRetrieveFoundRequest(SamsungHapticsStreamQueue, found, &attached);
+			WdfObjectDereference(found);
+
+			if (NT_SUCCESS(status)) {
+				WdfRequestComplete(attached, STATUS_SUCCESS);
+				SamsungHapticsStreamRequestDone(devContext);
+			}
+			break;
+		}
+
+		previous = found;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+SamsungHapticsStreamRundown(
+	_Inout_ PDEVICE_CONTEXT devContext
+)
+/*++
+Routine Description:
+
+	Detach the stream of a device being removed and wait for cancellations
+	still referring to it.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+	ULONG outstanding;
+
+	PAGED_CODE();
+
+	if (devContext->OutputLock == NULL) {
+		return;
+	}
+
+	SamsungHapticsStreamDetach(devContext);
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+	outstanding = stream->Outstanding;
+	WdfWaitLockRelease(devContext->OutputLock);
+
+	if (outstanding != 0) {
+		KeWaitForSingleObject(&stream->Released, Executive, KernelMode, FALSE, NULL);
+
+		//
+		// The last completion signals with OutputLock held; let it go.
+		//
+		WdfWaitLockAcquire(devContext->OutputLock, NULL);
+		WdfWaitLockRelease(devContext->OutputLock);
+	}
+}
+
+VOID
+SamsungHapticsStreamConsume(
+	_Inout_ PDEVICE_CONTEXT devContext,
+	_In_ ULONGLONG Edge
+)
+/*++
+Routine Description:
+
+	Take every sample due by Edge off the ring and apply the newest one,
+	then schedule the next poll. Called from the effect timer with
+	OutputLock held.
+
+--*/
+{
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+	PSAMSUNG_HAPTICS_STREAM_RING ring = stream->Ring;
+	LARGE_INTEGER start;
+	LARGE_INTEGER end;
+	LARGE_INTEGER frequency;
+	ULONGLONG now = KeQueryInterruptTime();
+	ULONGLONG next = 0;
+	ULONG intensity = stream->Intensity;
+	BOOLEAN due = FALSE;
+	ULONG producer;
+	ULONG pending;
+
+	if (ring == NULL) {
+		return;
+	}
+
+	start = KeQueryPerformanceCounter(NULL);
+	stream->Polls++;
+
+	producer = ReadULongAcquire(&ring->Producer);
+	pending = producer - stream->Consumer;
+	if (pending > stream->Capacity) {
+		//
+		// Not a count the client can have produced: skip to its index.
+		//
+		stream->Overruns++;
+		stream->Consumer = producer;
+		pending = 0;
+	}
+
+	while (pending != 0) {
+		PSAMSUNG_HAPTICS_STREAM_SAMPLE sample = &ring->Samples[stream->Consumer & (stream->Capacity - 1)];
+		ULONGLONG timestamp = ReadULong64NoFence(&sample->Timestamp);
+
+		if (timestamp > Edge) {
+			next = timestamp;
+			break;
+		}
+
+		if (due) {
+			stream->Superseded++;
+		}
+
+		intensity = min(ReadULongNoFence(&sample->Intensity), SAMSUNG_HAPTICS_MAX_INTENSITY);
+		due = TRUE;
+
+		stream->Consumer++;
+		stream->Consumed++;
+		pending--;
+	}
+
+	WriteULongRelease(&ring->Consumer, stream->Consumer);
+
+	if (due) {
+		stream->LastSample = now;
+	}
+	else if (pending == 0 && stream->Intensity != 0) {
+		stream->Underruns++;
+
+		if (now - stream->LastSample >= STREAM_TIMEOUT) {
+			stream->Timeouts++;
+			intensity = 0;
+		}
+	}
+
+	//
+	// Set before the voice changes, which re-arms the timer from it.
+	//
+	stream->NextPoll = now + ((intensity != 0) ? STREAM_ACTIVE_POLL : STREAM_IDLE_POLL);
+	if (next != 0) {
+		stream->NextPoll = min(stream->NextPoll, next);
+	}
+
+	if (intensity != stream->Intensity) {
+		NTSTATUS status = (intensity != 0) ?
+			SamsungHapticsMixerSetVoice(
+				devContext,
+				SamsungHapticsVoiceStream,
+				intensity,
+				0,
+				SamsungHapticsPriorityNormal,
+				SamsungHapticsPreemptResume) :
+			SamsungHapticsMixerClearVoice(devContext, SamsungHapticsVoiceStream);
+		if (NT_SUCCESS(status)) {
+			stream->Intensity = intensity;
+		}
+	}
+
+	end = KeQueryPerformanceCounter(&frequency);
+	stream->ConsumeNs += SamsungHapticsTicksToNs((ULONGLONG)(end.QuadPart - start.QuadPart), (ULONGLONG)frequency.QuadPart);
+}
+
+VOID
+SamsungHapticsStreamQuery(
+	_In_ PDEVICE_CONTEXT devContext,
+	_Out_ PSAMSUNG_HAPTICS_STREAM_STATISTICS Statistics
+)
+{
+	PSAMSUNG_HAPTICS_STREAM_STATE stream = &devContext->Stream;
+
+	PAGED_CODE();
+
+	WdfWaitLockAcquire(devContext->OutputLock, NULL);
+
+	Statistics->Attached = (stream->Request != NULL);
+	Statistics->Capacity = stream->Capacity;
+	Statistics->Intensity = stream->Intensity;
+	Statistics->Reserved = 0;
+	Statistics->Attaches = stream->Attaches;
+	Statistics->Consumed = stream->Consumed;
+	Statistics->Superseded = stream->Superseded;
+	Statistics->Underruns = stream->Underruns;
+	Statistics->Overruns = stream->Overruns;
+	Statistics->Timeouts = stream->Timeouts;
+	Statistics->Polls = stream->Polls;
+	Statistics->ConsumeNs = stream->ConsumeNs;
+
+	WdfWaitLockRelease(devContext->OutputLock);
+}
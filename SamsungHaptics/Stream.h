@@ -0,0 +1,99 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Stream.h
+
+Abstract:
+
+	Shared-memory intensity stream definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+typedef struct _SAMSUNG_HAPTICS_STREAM_STATE
+{
+	//
+	// Pending attach request locking the client's ring, and the ring's
+	// system mapping. NULL when no stream is attached.
+	//
+	WDFREQUEST Request;
+	ULONGLONG  Generation;      // tells this attach from earlier ones
+	PSAMSUNG_HAPTICS_STREAM_RING Ring;
+	ULONG      Capacity;
+	ULONG      Consumer;        // the driver's own copy, never read back from the ring
+
+	ULONG      Intensity;       // intensity of the stream voice, 0 when cleared
+	ULONGLONG  NextPoll;        // interrupt time, 0 when detached
+	ULONGLONG  LastSample;      // interrupt time a sample was last applied
+
+	//
+	// Attach requests not completed yet. Released is signaled when there
+	// are none, so the device can go away.
+	//
+	ULONG      Outstanding;
+	KEVENT     Released;
+
+	ULONGLONG Attaches;
+	ULONGLONG Consumed;
+	ULONGLONG Superseded;
+	ULONGLONG Underruns;
+	ULONGLONG Overruns;
+	ULONGLONG Timeouts;
+	ULONGLONG Polls;
+	ULONGLONG ConsumeNs;
+} SAMSUNG_HAPTICS_STREAM_STATE, * PSAMSUNG_HAPTICS_STREAM_STATE;
+
+struct _DEVICE_CONTEXT;
+
+VOID
+SamsungHapticsStreamInitialize(
+	_Out_ PSAMSUNG_HAPTICS_STREAM_STATE Stream
+);
+
+NTSTATUS
+SamsungHapticsStreamQueueCreate(
+	_In_ WDFDEVICE ControlDevice
+);
+
+NTSTATUS
+SamsungHapticsStreamAttach(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ WDFREQUEST Request
+);
+
+NTSTATUS
+SamsungHapticsStreamDetach(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsStreamRundown(
+	_Inout_ struct _DEVICE_CONTEXT* devContext
+);
+
+VOID
+SamsungHapticsStreamConsume(
+	_Inout_ struct _DEVICE_CONTEXT* devContext,
+	_In_ ULONGLONG Edge
+);
+
+VOID
+SamsungHapticsStreamQuery(
+	_In_ struct _DEVICE_CONTEXT* devContext,
+	_Out_ PSAMSUNG_HAPTICS_STREAM_STATISTICS Statistics
+);
+
+EXTERN_C_END
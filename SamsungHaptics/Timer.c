@@ -0,0 +1,544 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Timer.c - Timing of pin output
+
+Abstract:
+
+	Every timed pin write (modulator ticks, kicks, minimum pulses, ON time
+	limits) goes through this timer. Pin writes must be issued at
+	PASSIVE_LEVEL, so each timer owns a real-time priority thread that runs
+	the callback; the backend only decides how that thread is woken:
+
+	- HighResolution: an EX_TIMER_HIGH_RESOLUTION timer. Precise, but
+	  forces the system clock to a high rate while armed.
+	- Coalescable: a KTIMER with a tolerable delay, which the kernel may
+	  batch with other expirations. Cheapest on power, 1 ms granularity.
+	- Spin: the high resolution timer wakes the thread shortly before
+	  the deadline and it spins on the performance counter for the rest.
+	  For sub-millisecond work; the spin is capped to a fraction of the
+	  period so periodic timers leave the core idle most of the time.
+
+	The backend is selected per device by the tuning profile. The error
+	between deadline and callback dispatch is accumulated per timer.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#include "driver.h"
+#include "timer.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, SamsungHapticsTimerInitialize)
+#pragma alloc_text (PAGE, SamsungHapticsTimerUninitialize)
+#endif
+
+#define TIMER_SPIN_WINDOW        500     // spin for at most the last 50 us
+#define TIMER_SPIN_PERIOD_SHARE  4       // and for at most a quarter of the period
+#define TIMER_EARLY_SLACK        1000    // wake-ups earlier than 100 us are stale
+#define TIMER_COALESCABLE_PERIOD 10000   // KTIMER periods are whole milliseconds
+#define TIMER_TOLERABLE_DELAY_MS 1
+
+static const ULONG SamsungHapticsTimerHistogramLimitsUs[SAMSUNG_HAPTICS_TIMER_HISTOGRAM_BUCKETS - 1] =
+{
+	10, 25, 50, 100, 250, 500, 1000
+};
+
+LONGLONG
+SamsungHapticsTimerNow(
+	VOID
+)
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter = KeQueryPerformanceCounter(&frequency);
+
+	return (counter.QuadPart / frequency.QuadPart) * 10000000 +
+		(counter.QuadPart % frequency.QuadPart) * 10000000 / frequency.QuadPart;
+}
+
+static
+VOID
+SamsungHapticsTimerHighResolutionCallback(
+	_In_ PEX_TIMER ExTimer,
+	_In_opt_ PVOID Context
+)
+{
+	PSAMSUNG_HAPTICS_TIMER timer = (PSAMSUNG_HAPTICS_TIMER)Context;
+
+	UNREFERENCED_PARAMETER(ExTimer);
+
+	KeSetEvent(&timer->WakeEvent, IO_NO_INCREMENT, FALSE);
+}
+
+static
+VOID
+SamsungHapticsTimerCoalescableDpc(
+	_In_ PKDPC Dpc,
+	_In_opt_ PVOID Context,
+	_In_opt_ PVOID SystemArgument1,
+	_In_opt_ PVOID SystemArgument2
+)
+{
+	PSAMSUNG_HAPTICS_TIMER timer = (PSAMSUNG_HAPTICS_TIMER)Context;
+
+	UNREFERENCED_PARAMETER(Dpc);
+	UNREFERENCED_PARAMETER(SystemArgument1);
+	UNREFERENCED_PARAMETER(SystemArgument2);
+
+	KeSetEvent(&timer->WakeEvent, IO_NO_INCREMENT, FALSE);
+}
+
+static
+LONGLONG
+SamsungHapticsTimerSpinWindow(
+	_In_ LONGLONG Period
+)
+{
+	if (Period != 0) {
+		return min(TIMER_SPIN_WINDOW, Period / TIMER_SPIN_PERIOD_SHARE);
+	}
+
+	return TIMER_SPIN_WINDOW;
+}
+
+static
+VOID
+SamsungHapticsTimerArmBackend(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ LONGLONG DueTime,
+	_In_ LONGLONG Period
+)
+/*++
+Routine Description:
+
+	Program the selected backend. Must be called with Lock held.
+
+--*/
+{
+	switch (Timer->Backend) {
+	case SamsungHapticsTimerHighResolution:
+		KeClearEvent(&Timer->WakeEvent);
+		ExSetTimer(Timer->HighResolutionTimer, -DueTime, Period, NULL);
+		break;
+	case SamsungHapticsTimerSpin:
+	{
+		//
+		// Wake the thread one spin window before every deadline; the
+		// period keeps the wake-ups in phase with the deadlines.
+		//
+		LONGLONG window = SamsungHapticsTimerSpinWindow(Period);
+
+		KeClearEvent(&Timer->WakeEvent);
+		ExSetTimer(Timer->HighResolutionTimer, -max(DueTime - window, 1), Period, NULL);
+		break;
+	}
+	case SamsungHapticsTimerCoalescable:
+	{
+		LARGE_INTEGER dueTime;
+
+		dueTime.QuadPart = -DueTime;
+		KeClearEvent(&Timer->WakeEvent);
+		KeSetCoalescableTimer(
+			&Timer->CoalescableTimer,
+			dueTime,
+			(ULONG)(Period / 10000),
+			TIMER_TOLERABLE_DELAY_MS,
+			&Timer->CoalescableDpc);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static
+VOID
+SamsungHapticsTimerDisarmBackend(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer
+)
+{
+	switch (Timer->Backend) {
+	case SamsungHapticsTimerHighResolution:
+	case SamsungHapticsTimerSpin:
+		ExCancelTimer(Timer->HighResolutionTimer, NULL);
+		break;
+	case SamsungHapticsTimerCoalescable:
+		KeCancelTimer(&Timer->CoalescableTimer);
+		break;
+	default:
+		break;
+	}
+}
+
+static
+VOID
+SamsungHapticsTimerRecord(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER_STATISTICS Statistics,
+	_In_ LONGLONG Error
+)
+{
+	ULONGLONG errorUs;
+	ULONG bucket;
+
+	Statistics->Expirations++;
+
+	if (Error < 0) {
+		Statistics->Early++;
+		Error = -Error;
+	}
+
+	errorUs = (ULONGLONG)Error / 10;
+	Statistics->TotalErrorUs += errorUs;
+	Statistics->MaxErrorUs = max(Statistics->MaxErrorUs, errorUs);
+
+	for (bucket = 0; bucket < ARRAYSIZE(SamsungHapticsTimerHistogramLimitsUs); bucket++) {
+		if (errorUs <= SamsungHapticsTimerHistogramLimitsUs[bucket]) {
+			break;
+		}
+	}
+
+	Statistics->Histogram[bucket]++;
+}
+
+static
+BOOLEAN
+SamsungHapticsTimerExpire(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer
+)
+/*++
+Routine Description:
+
+	Consume the pending deadline if it is due, and schedule the next
+	period.
+
+Return Value:
+
+	TRUE if the callback should run.
+
+--*/
+{
+	KIRQL irql;
+	LONGLONG now;
+	LONGLONG deadline;
+	LONGLONG slack;
+	BOOLEAN expired = FALSE;
+
+	KeAcquireSpinLock(&Timer->Lock, &irql);
+
+	now = SamsungHapticsTimerNow();
+	deadline = Timer->Deadline;
+	slack = (Timer->Backend == SamsungHapticsTimerSpin) ? 0 : TIMER_EARLY_SLACK;
+
+	if (deadline != 0 && now >= deadline - slack) {
+		SamsungHapticsTimerRecord(&Timer->Statistics, now - deadline);
+
+		if (Timer->Period != 0) {
+			LONGLONG next = deadline + Timer->Period;
+
+			if (next <= now) {
+				LONGLONG missed = (now - next) / Timer->Period + 1;
+
+				Timer->Statistics.Missed += (ULONGLONG)missed;
+				next += missed * Timer->Period;
+			}
+
+			Timer->Deadline = next;
+		}
+		else {
+			Timer->Deadline = 0;
+		}
+
+		expired = TRUE;
+	}
+
+	KeReleaseSpinLock(&Timer->Lock, irql);
+
+	return expired;
+}
+
+static
+VOID
+SamsungHapticsTimerSpinUntil(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ LONGLONG Deadline
+)
+{
+	while (SamsungHapticsTimerNow() < Deadline) {
+		if (ReadNoFence(&Timer->StopThread) ||
+			ReadNoFence64(&Timer->Deadline) != Deadline) {
+			break;
+		}
+
+		YieldProcessor();
+	}
+}
+
+static
+VOID
+SamsungHapticsTimerThread(
+	_In_ PVOID Context
+)
+{
+	PSAMSUNG_HAPTICS_TIMER timer = (PSAMSUNG_HAPTICS_TIMER)Context;
+
+	KeSetPriorityThread(KeGetCurrentThread(), LOW_REALTIME_PRIORITY);
+
+	for (;;)
+	{
+		LONGLONG deadline;
+
+		KeWaitForSingleObject(&timer->WakeEvent, Executive, KernelMode, FALSE, NULL);
+
+		if (ReadNoFence(&timer->StopThread))
+		{
+			break;
+		}
+
+		//
+		// Only spin when woken inside the window, so a stale wake-up
+		// never turns into a long busy wait.
+		//
+		deadline = ReadNoFence64(&timer->Deadline);
+		if (timer->Backend == SamsungHapticsTimerSpin && deadline != 0 &&
+			deadline - SamsungHapticsTimerNow() <= TIMER_SPIN_WINDOW)
+		{
+			SamsungHapticsTimerSpinUntil(timer, deadline);
+		}
+
+		if (SamsungHapticsTimerExpire(timer)) {
+			timer->Callback(timer->Context);
+		}
+	}
+
+	PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+NTSTATUS
+SamsungHapticsTimerInitialize(
+	_Out_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ PSAMSUNG_HAPTICS_TIMER_CALLBACK Callback,
+	_In_ PVOID Context
+)
+/*++
+Routine Description:
+
+	Allocate the backend timers and start the callback thread. The timer
+	starts disarmed on the high resolution backend.
+
+--*/
+{
+	NTSTATUS status;
+	HANDLE threadHandle;
+
+	PAGED_CODE();
+
+	RtlZeroMemory(Timer, sizeof(*Timer));
+	Timer->Backend = SamsungHapticsTimerHighResolution;
+	Timer->Callback = Callback;
+	Timer->Context = Context;
+	KeInitializeSpinLock(&Timer->Lock);
+	KeInitializeEvent(&Timer->WakeEvent, SynchronizationEvent, FALSE);
+	KeInitializeTimerEx(&Timer->CoalescableTimer, NotificationTimer);
+	KeInitializeDpc(&Timer->CoalescableDpc, SamsungHapticsTimerCoalescableDpc, Timer);
+
+	Timer->HighResolutionTimer = ExAllocateTimer(
+		SamsungHapticsTimerHighResolutionCallback,
+		Timer,
+		EX_TIMER_HIGH_RESOLUTION);
+	if (Timer->HighResolutionTimer == NULL) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "ExAllocateTimer failed");
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	status = PsCreateSystemThread(
+		&threadHandle,
+		THREAD_ALL_ACCESS,
+		NULL,
+		NULL,
+		NULL,
+		SamsungHapticsTimerThread,
+		Timer);
+	if (!NT_SUCCESS(status)) {
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "PsCreateSystemThread failed - %!STATUS!", status);
+		goto exit;
+	}
+
+	status = ObReferenceObjectByHandle(
+		threadHandle,
+		THREAD_ALL_ACCESS,
+		*PsThreadType,
+		KernelMode,
+		(PVOID*)&Timer->Thread,
+		NULL);
+	ZwClose(threadHandle);
+
+	if (!NT_SUCCESS(status)) {
+		//
+		// Cannot happen for a handle we just created; ask the thread to
+		// exit since we have no object to wait on.
+		//
+		Trace(TRACE_LEVEL_ERROR, TRACE_INIT, "ObReferenceObjectByHandle failed - %!STATUS!", status);
+		Timer->Thread = NULL;
+		InterlockedExchange(&Timer->StopThread, TRUE);
+		KeSetEvent(&Timer->WakeEvent, IO_NO_INCREMENT, FALSE);
+	}
+
+exit:
+	if (!NT_SUCCESS(status)) {
+		ExDeleteTimer(Timer->HighResolutionTimer, TRUE, TRUE, NULL);
+		Timer->HighResolutionTimer = NULL;
+	}
+
+	return status;
+}
+
+VOID
+SamsungHapticsTimerUninitialize(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer
+)
+/*++
+Routine Description:
+
+	Stop the timer and wait for the callback thread to exit. Must not be
+	called from the callback or with a lock the callback takes.
+
+--*/
+{
+	PAGED_CODE();
+
+	if (Timer->HighResolutionTimer != NULL) {
+		SamsungHapticsTimerSetBackend(Timer, SamsungHapticsTimerHighResolution);
+		SamsungHapticsTimerCancel(Timer);
+
+		ExDeleteTimer(Timer->HighResolutionTimer, TRUE, TRUE, NULL);
+		Timer->HighResolutionTimer = NULL;
+		KeFlushQueuedDpcs();
+	}
+
+	if (Timer->Thread != NULL) {
+		InterlockedExchange(&Timer->StopThread, TRUE);
+		KeSetEvent(&Timer->WakeEvent, IO_NO_INCREMENT, FALSE);
+		KeWaitForSingleObject(Timer->Thread, Executive, KernelMode, FALSE, NULL);
+		ObDereferenceObject(Timer->Thread);
+		Timer->Thread = NULL;
+	}
+}
+
+VOID
+SamsungHapticsTimerSetBackend(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ SAMSUNG_HAPTICS_TIMER_BACKEND Backend
+)
+/*++
+Routine Description:
+
+	Move the timer to another backend, keeping a pending deadline. The
+	statistics restart so they describe a single backend. Callers serialize
+	Set, Cancel and SetBackend; for output timers that is OutputLock.
+
+--*/
+{
+	KIRQL irql;
+
+	if (Backend == Timer->Backend) {
+		return;
+	}
+
+	KeAcquireSpinLock(&Timer->Lock, &irql);
+
+	SamsungHapticsTimerDisarmBackend(Timer);
+
+	Timer->Backend = Backend;
+	RtlZeroMemory(&Timer->Statistics, sizeof(Timer->Statistics));
+
+	if (Backend == SamsungHapticsTimerCoalescable && Timer->Period != 0) {
+		Timer->Period = max(Timer->Period, TIMER_COALESCABLE_PERIOD);
+	}
+
+	if (Timer->Deadline != 0) {
+		SamsungHapticsTimerArmBackend(
+			Timer,
+			max(Timer->Deadline - SamsungHapticsTimerNow(), 1),
+			Timer->Period);
+	}
+
+	KeReleaseSpinLock(&Timer->Lock, irql);
+}
+
+VOID
+SamsungHapticsTimerSet(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ LONGLONG DueTime,
+	_In_ LONGLONG Period
+)
+/*++
+Routine Description:
+
+	Arm the timer DueTime from now (100 ns units), then every Period if
+	non-zero. Re-arming replaces the previous schedule. A callback already
+	dispatched may still run, so callbacks re-check their own state.
+
+--*/
+{
+	KIRQL irql;
+
+	DueTime = max(DueTime, 1);
+
+	KeAcquireSpinLock(&Timer->Lock, &irql);
+
+	if (Timer->Backend == SamsungHapticsTimerCoalescable && Period != 0) {
+		Period = max(Period, TIMER_COALESCABLE_PERIOD);
+	}
+
+	Timer->Deadline = SamsungHapticsTimerNow() + DueTime;
+	Timer->Period = Period;
+	SamsungHapticsTimerArmBackend(Timer, DueTime, Period);
+
+	KeReleaseSpinLock(&Timer->Lock, irql);
+}
+
+VOID
+SamsungHapticsTimerCancel(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer
+)
+/*++
+Routine Description:
+
+	Disarm the timer without waiting for a callback in progress.
+
+--*/
+{
+	KIRQL irql;
+
+	KeAcquireSpinLock(&Timer->Lock, &irql);
+
+	Timer->Deadline = 0;
+	Timer->Period = 0;
+	SamsungHapticsTimerDisarmBackend(Timer);
+
+	KeReleaseSpinLock(&Timer->Lock, irql);
+}
+
+VOID
+SamsungHapticsTimerQuery(
+	_In_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_Out_ PSAMSUNG_HAPTICS_TIMER_STATISTICS Statistics
+)
+{
+	KIRQL irql;
+
+	KeAcquireSpinLock(&Timer->Lock, &irql);
+
+	*Statistics = Timer->Statistics;
+	Statistics->Backend = Timer->Backend;
+	Statistics->Reserved = 0;
+
+	KeReleaseSpinLock(&Timer->Lock, irql);
+}
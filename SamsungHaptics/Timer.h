@@ -0,0 +1,104 @@
+/*++
+	Copyright (c) DuoWoA authors. All Rights Reserved.
+
+	SPDX-License-Identifier: BSD-3-Clause
+
+Module Name:
+
+	Timer.h
+
+Abstract:
+
+	Output timer definitions.
+
+Environment:
+
+	Kernel-mode Driver Framework
+
+--*/
+
+#pragma once
+
+#include "public.h"
+
+EXTERN_C_START
+
+typedef
+VOID
+SAMSUNG_HAPTICS_TIMER_CALLBACK(
+	_In_ PVOID Context
+);
+
+typedef SAMSUNG_HAPTICS_TIMER_CALLBACK* PSAMSUNG_HAPTICS_TIMER_CALLBACK;
+
+typedef struct _SAMSUNG_HAPTICS_TIMER
+{
+	SAMSUNG_HAPTICS_TIMER_BACKEND   Backend;
+	PSAMSUNG_HAPTICS_TIMER_CALLBACK Callback;
+	PVOID                           Context;
+
+	//
+	// Kernel timers waking the thread; only the selected backend is armed
+	//
+	PEX_TIMER HighResolutionTimer;
+	KTIMER    CoalescableTimer;
+	KDPC      CoalescableDpc;
+
+	//
+	// Schedule in 100 ns units of the performance counter, protected by
+	// Lock. Deadline is 0 when the timer is not armed, Period is 0 for a
+	// one-shot.
+	//
+	KSPIN_LOCK Lock;
+	LONGLONG   Deadline;
+	LONGLONG   Period;
+
+	KEVENT        WakeEvent;
+	PKTHREAD      Thread;
+	volatile LONG StopThread;
+
+	SAMSUNG_HAPTICS_TIMER_STATISTICS Statistics;
+} SAMSUNG_HAPTICS_TIMER, * PSAMSUNG_HAPTICS_TIMER;
+
+LONGLONG
+SamsungHapticsTimerNow(
+	VOID
+);
+
+NTSTATUS
+SamsungHapticsTimerInitialize(
+	_Out_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ PSAMSUNG_HAPTICS_TIMER_CALLBACK Callback,
+	_In_ PVOID Context
+);
+
+VOID
+SamsungHapticsTimerUninitialize(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer
+);
+
+VOID
+SamsungHapticsTimerSetBackend(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ SAMSUNG_HAPTICS_TIMER_BACKEND Backend
+);
+
+VOID
+SamsungHapticsTimerSet(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_In_ LONGLONG DueTime,
+	_In_ LONGLONG Period
+);
+
+VOID
+SamsungHapticsTimerCancel(
+	_Inout_ PSAMSUNG_HAPTICS_TIMER Timer
+);
+
+VOID
+SamsungHapticsTimerQuery(
+	_In_ PSAMSUNG_HAPTICS_TIMER Timer,
+	_Out_ PSAMSUNG_HAPTICS_TIMER_STATISTICS Statistics
+);
+
+EXTERN_C_END